@@ -0,0 +1,152 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#include <stddef.h>
+
+#include "engine.h"
+#include "exec.h"
+
+/* Applies X(E, S, type, a_mode, b_mode) to every encoding, in opcode order,
+ * where E names the engine and S is its core size. */
+#define ENCODINGS_FOR_A(X, E, S, t, a) \
+    X(E, S, t, a, 0) X(E, S, t, a, 1) X(E, S, t, a, 2) X(E, S, t, a, 3)
+
+#define ENCODINGS_FOR_TYPE(X, E, S, t) \
+    ENCODINGS_FOR_A(X, E, S, t, 0) ENCODINGS_FOR_A(X, E, S, t, 1) \
+    ENCODINGS_FOR_A(X, E, S, t, 2) ENCODINGS_FOR_A(X, E, S, t, 3)
+
+#define FOR_EACH_ENCODING(X, E, S) \
+    ENCODINGS_FOR_TYPE(X, E, S, 0) ENCODINGS_FOR_TYPE(X, E, S, 1) \
+    ENCODINGS_FOR_TYPE(X, E, S, 2) ENCODINGS_FOR_TYPE(X, E, S, 3) \
+    ENCODINGS_FOR_TYPE(X, E, S, 4) ENCODINGS_FOR_TYPE(X, E, S, 5) \
+    ENCODINGS_FOR_TYPE(X, E, S, 6) ENCODINGS_FOR_TYPE(X, E, S, 7) \
+    ENCODINGS_FOR_TYPE(X, E, S, 8) ENCODINGS_FOR_TYPE(X, E, S, 9) \
+    ENCODINGS_FOR_TYPE(X, E, S, 10) ENCODINGS_FOR_TYPE(X, E, S, 11) \
+    ENCODINGS_FOR_TYPE(X, E, S, 12) ENCODINGS_FOR_TYPE(X, E, S, 13) \
+    ENCODINGS_FOR_TYPE(X, E, S, 14) ENCODINGS_FOR_TYPE(X, E, S, 15)
+
+/* One handler is generated for every encoding, including the invalid ones, by
+ * specializing execute() on constants. */
+#define HANDLER(E, S, t, a, b) \
+    static unsigned int E##_handle_##t##_##a##_##b(mars* m, unsigned int pc, \
+                                                   const predecoded* d) { \
+        return execute(m, pc, d, t, a, b, CORE_SIZE(m, S)); \
+    }
+
+#define HANDLER_ENTRY(E, S, t, a, b) E##_handle_##t##_##a##_##b,
+
+#define LABEL_ENTRY(E, S, t, a, b) &&op_##t##_##a##_##b,
+
+/* Body of the threaded loop for one encoding: execute it, retire the turn and
+ * jump straight to the next warrior's instruction. Illegal encodings all share
+ * the single path that kills the warrior. */
+#define THREADED_OP(E, S, t, a, b) \
+    op_##t##_##a##_##b: \
+        if(!is_legal(t, a, b)) { \
+            goto died; \
+        } \
+        w->PC = execute(m, pc, d, t, a, b, CORE_SIZE(m, S)); \
+        w = &warriors[w->next]; \
+        elapsed++; \
+        DISPATCH(S);
+
+#define DISPATCH(S) \
+    do { \
+        pc = w->PC; \
+        d = fetch(m, pc); \
+        if(elapsed >= m->stop_at) { \
+            goto done; \
+        } \
+        __extension__ ({ goto *labels[HANDLER_INDEX(d->raw)]; }); \
+    } while(0)
+
+/* Defines the engine E for core size S: its handler table for tick(), and a
+ * direct-threaded run loop which keeps the running warrior, its PC and the
+ * cycle counter in locals, writing them back to the mars when it stops. The
+ * loop stops at the tick given to it, after a warrior dies, or as soon as a
+ * hook of run_cycles() clears m->stop_at. */
+#define DEFINE_ENGINE(E, S) \
+    FOR_EACH_ENCODING(HANDLER, E, S) \
+    \
+    static const handler E##_handlers[HANDLER_COUNT] = { \
+        FOR_EACH_ENCODING(HANDLER_ENTRY, E, S) \
+    }; \
+    \
+    static void E##_run(mars* m, unsigned int until) { \
+        __extension__ static const void* const labels[HANDLER_COUNT] = { \
+            FOR_EACH_ENCODING(LABEL_ENTRY, E, S) \
+        }; \
+        \
+        if(m->alive_count == 0) { \
+            return; \
+        } \
+        \
+        unsigned int elapsed = m->elapsed; \
+        warrior* const warriors = m->warriors; \
+        warrior* w = &warriors[m->next_warrior]; \
+        unsigned int pc; \
+        const predecoded* d; \
+        \
+        m->stop_at = until; \
+        \
+        DISPATCH(S); \
+        FOR_EACH_ENCODING(THREADED_OP, E, S) \
+    died: \
+        m->elapsed = elapsed; \
+        m->next_warrior = (unsigned int) (w - warriors); \
+        kill_warrior(m, m->next_warrior); \
+        m->elapsed++; \
+        return; \
+    done: \
+        m->elapsed = elapsed; \
+        m->next_warrior = (unsigned int) (w - warriors); \
+    }
+
+DEFINE_ENGINE(generic, 0)
+DEFINE_ENGINE(core_8000, 8000)
+DEFINE_ENGINE(core_8192, 8192)
+DEFINE_ENGINE(core_4096, 4096)
+DEFINE_ENGINE(core_10, 10)
+DEFINE_ENGINE(core_5, 5)
+
+const engine generic_engine = { 0, generic_handlers, generic_run };
+
+static const engine fixed_engines[] = {
+    { 8000, core_8000_handlers, core_8000_run },
+    { 8192, core_8192_handlers, core_8192_run },
+    { 4096, core_4096_handlers, core_4096_run },
+    { 10, core_10_handlers, core_10_run },
+    { 5, core_5_handlers, core_5_run }
+};
+
+/* Returns the engine specialized for the given core size, or the generic
+ * engine if there is none.
+ *
+ * @param core_size - the size of the core the engine will run on
+ * @return an engine that can run a mars of the given size */
+const engine* select_engine(unsigned int core_size) {
+    for(size_t i=0; i<sizeof(fixed_engines) / sizeof(fixed_engines[0]); i++) {
+        if(fixed_engines[i].core_size == core_size) {
+            return &fixed_engines[i];
+        }
+    }
+
+    return &generic_engine;
+}
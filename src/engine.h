@@ -0,0 +1,52 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_ENGINE_H_
+#define COREWARS_1984_ENGINE_H_
+
+#include "mars.h"
+
+/* Handlers are indexed by the top byte of an opcode, which packs the type,
+ * A-mode and B-mode of the instruction. */
+#define HANDLER_COUNT 256
+#define HANDLER_INDEX(op) ((op) >> B_MODE_OFFSET)
+
+/* Executes the predecoded instruction d, located at pc, and returns the
+ * address of the warrior's next instruction, or DIED. */
+typedef unsigned int (*handler)(mars* m, unsigned int pc, const predecoded* d);
+
+/* Runs a battle on the given mars until the given tick, until a warrior dies,
+ * or until a hook set up by run_cycles() fires. */
+typedef void (*runner)(mars* m, unsigned int until);
+
+/* An instance of the simulator compiled for one core size, or for any size
+ * when core_size is 0. */
+typedef struct engine {
+    unsigned int core_size;
+    const handler* handlers;
+    runner run;
+} engine;
+
+extern const engine generic_engine;
+
+const engine* select_engine(unsigned int core_size);
+void kill_warrior(mars* m, unsigned int index);
+
+#endif
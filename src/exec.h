@@ -0,0 +1,209 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+/* Instruction semantics shared by every execution engine. This header is
+ * internal to the simulator; everything in it is inlined into the engines so
+ * that constant instruction types and modes fold away. */
+
+#ifndef COREWARS_1984_EXEC_H_
+#define COREWARS_1984_EXEC_H_
+
+#include <limits.h>
+
+#include "mars.h"
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/* Returned by execute() in place of a PC when the warrior has died. */
+#define DIED UINT_MAX
+
+/* Engines for a fixed core size pass it as the constant S, and the generic
+ * engine passes 0 to use the size stored in the mars. */
+#define CORE_SIZE(m, S) ((S) ? (S) : (m)->core_size)
+
+/* Wraps an address into [0, size). Unlike wrap_index(), a constant size lets
+ * the compiler replace the division: power-of-two sizes become a mask and
+ * the others a multiplication by a constant. */
+static ALWAYS_INLINE unsigned int wrap_address(int index, unsigned int size) {
+    if((size & (size - 1)) == 0) {
+        return (unsigned int) index & (size - 1);
+    }
+
+    int wrapped = index % (int) size;
+
+    if(wrapped < 0) {
+        return (unsigned int) (wrapped + (int) size);
+    } else {
+        return (unsigned int) wrapped;
+    }
+}
+
+/* Rebuilds the predecoded entry of a cell of a core with the given size. */
+static ALWAYS_INLINE void decode_cell(mars* m, unsigned int index,
+                                      unsigned int size) {
+    predecoded* d = &m->decoded[index];
+    opcode op = m->core[index];
+
+    d->raw = op;
+    d->type = (uint8_t) ((op & OP_TYPE_MASK) >> TYPE_OFFSET);
+    d->a_mode = (uint8_t) ((op & A_MODE_MASK) >> A_MODE_OFFSET);
+    d->b_mode = (uint8_t) ((op & B_MODE_MASK) >> B_MODE_OFFSET);
+    d->a = get_signed_operand_value((op & A_MASK) >> A_OFFSET);
+    d->b = get_signed_operand_value((op & B_MASK) >> B_OFFSET);
+    d->a_target = wrap_address((int) index + d->a, size);
+    d->b_target = wrap_address((int) index + d->b, size);
+}
+
+/* Writes a value into the given core cell, keeping its predecoded entry in
+ * sync and marking its chunk dirty for reset_mars(). All writes made by the
+ * simulator should go through here. Optional copies of the core, which most
+ * battles do not use, are updated out of line by sync_cell(). */
+static ALWAYS_INLINE void store(mars* m, unsigned int index, opcode value,
+                                unsigned int size) {
+    opcode old = m->core[index];
+
+    m->core[index] = value;
+    m->dirty[index / DIRTY_CHUNK] = 1;
+    decode_cell(m, index, size);
+
+    if(__builtin_expect(m->write_barrier != 0, 0)) {
+        sync_cell(m, index, old);
+    }
+}
+
+/* Returns the predecoded entry for the instruction at the given address. The
+ * entry is refreshed if the core was written behind the simulator's back, e.g.
+ * by a test or debugger poking m->core directly. That is rare, so the refresh
+ * is left out of line. */
+static ALWAYS_INLINE const predecoded* fetch(mars* m, unsigned int index) {
+    if(__builtin_expect(m->decoded[index].raw != m->core[index], 0)) {
+        predecode(m, index);
+    }
+
+    return &m->decoded[index];
+}
+
+/* Returns the address following the given one, wrapping around the core. */
+static ALWAYS_INLINE unsigned int next_address(unsigned int index,
+                                               unsigned int size) {
+    return index + 1 == size ? 0 : index + 1;
+}
+
+/* Returns the value of a valid (immediate, relative or indirect) operand. */
+static ALWAYS_INLINE int load_operand(mars* m, unsigned int pc,
+                                      unsigned int mode, int value,
+                                      unsigned int target, unsigned int size) {
+    if(mode == IMMEDIATE_MODE) {
+        return value;
+    } else if(mode == RELATIVE_MODE) {
+        return (int) m->core[target];
+    } else {
+        value = (int) m->core[target];
+        return (int) m->core[wrap_address((int) pc + value, size)];
+    }
+}
+
+/* Returns the address of a valid (relative or indirect) operand. */
+static ALWAYS_INLINE unsigned int resolve_operand(mars* m, unsigned int pc,
+                                                  unsigned int mode,
+                                                  unsigned int target,
+                                                  unsigned int size) {
+    if(mode == RELATIVE_MODE) {
+        return target;
+    } else {
+        return wrap_address((int) pc + (int) m->core[target], size);
+    }
+}
+
+/* Returns whether an instruction with the given type and modes can execute.
+ * DAT and the unused types kill the warrior that runs them, as does any
+ * operand the instruction uses with an invalid mode, or an immediate B
+ * operand for an instruction that writes to or jumps to its B address. */
+static ALWAYS_INLINE bool is_legal(unsigned int type, unsigned int a_mode,
+                                   unsigned int b_mode) {
+    if(type == DAT_TYPE || type > CMP_TYPE || b_mode > INDIRECT_MODE) {
+        return false;
+    } else if(type != JMP_TYPE && a_mode > INDIRECT_MODE) {
+        return false;
+    } else if(type != CMP_TYPE && b_mode == IMMEDIATE_MODE) {
+        return false;
+    } else {
+        return true;
+    }
+}
+
+/* Executes the predecoded instruction d, located at pc, on a mars whose core
+ * has the given size. The type and modes are passed separately from d so that
+ * callers giving constants get a version specialized to that encoding, which
+ * only touches the memory that its semantics need.
+ *
+ * @return the address of the warrior's next instruction, or DIED */
+static ALWAYS_INLINE unsigned int execute(mars* m, unsigned int pc,
+                                          const predecoded* d,
+                                          unsigned int type,
+                                          unsigned int a_mode,
+                                          unsigned int b_mode,
+                                          unsigned int size) {
+    if(!is_legal(type, a_mode, b_mode)) {
+        return DIED;
+    }
+
+    int a = 0;
+    unsigned int b_addr = 0;
+
+    if(type != JMP_TYPE) {
+        a = load_operand(m, pc, a_mode, d->a, d->a_target, size);
+    }
+
+    if(type != CMP_TYPE) {
+        b_addr = resolve_operand(m, pc, b_mode, d->b_target, size);
+    }
+
+    switch (type) {
+        case MOV_TYPE:
+            store(m, b_addr, (opcode) a, size);
+            break;
+        case ADD_TYPE:
+            // Do normal unsigned int addition. No wrap on operand boundaries.
+            store(m, b_addr, (opcode) ((int) m->core[b_addr] + a), size);
+            break;
+        case SUB_TYPE:
+            store(m, b_addr, (opcode) ((int) m->core[b_addr] - a), size);
+            break;
+        case JMP_TYPE:
+            return b_addr;
+        case JMZ_TYPE:
+            if(a == 0)
+                return b_addr;
+            break;
+        case DJZ_TYPE:
+            if(a - 1 == 0)
+                return b_addr;
+            break;
+        case CMP_TYPE:
+            if(a != load_operand(m, pc, b_mode, d->b, d->b_target, size))
+                return next_address(next_address(pc, size), size);
+            break;
+    }
+
+    return next_address(pc, size);
+}
+
+#endif
@@ -0,0 +1,247 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+/* A farm of worker processes for playing battles in isolation, so that an
+ * untrusted program or an engine bug that brings down a worker cannot take
+ * the driver with it. The workers are forked once, up front, and share an
+ * anonymous mapping with the parent holding the queue of battles and their
+ * results. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "farm.h"
+
+/* Marks a worker slot which is not running a battle. */
+#define NO_BATTLE 0xFFFFFFFFu
+
+/* How many times spawn() tries to fork a worker, and how long it waits after
+ * the first failure, in nanoseconds, doubling after each one. */
+#define SPAWN_ATTEMPTS 5
+#define SPAWN_BACKOFF_NS 1000000
+
+/* The memory shared by the parent and the workers of a farm. Battles to play
+ * are queued in a ring, which holds each battle at most twice, since a battle
+ * is resubmitted at most once. Each worker records the battle it is playing
+ * in its slot of current, so that the parent knows what to resubmit if it
+ * dies, and results holds the result of each battle. */
+typedef struct farm {
+    pthread_mutex_t lock;
+    unsigned int capacity;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int* ring;
+    unsigned int* current;
+    unsigned int* attempts;
+    int* results;
+} farm;
+
+/* Takes the lock of a farm. The lock is robust, so a worker which dies
+ * holding it does not leave it held for good; the queue is still usable, as
+ * workers only ever leave it with a battle taken twice, never lost. */
+static void lock(farm* f) {
+    if(pthread_mutex_lock(&f->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&f->lock);
+    }
+}
+
+/* Adds a battle to the queue. The lock must be held. */
+static void submit(farm* f, unsigned int battle) {
+    f->ring[f->tail % f->capacity] = battle;
+    f->tail++;
+    f->attempts[battle]++;
+}
+
+/* The loop of a worker process, which plays queued battles until the queue is
+ * empty. */
+static void work(farm* f, unsigned int slot, battle_fn play, void* context) {
+    for(;;) {
+        lock(f);
+
+        if(f->head == f->tail) {
+            pthread_mutex_unlock(&f->lock);
+            return;
+        }
+
+        unsigned int battle = f->ring[f->head % f->capacity];
+        f->current[slot] = battle;
+        f->head++;
+        pthread_mutex_unlock(&f->lock);
+
+        f->results[battle] = play(context, battle);
+
+        lock(f);
+        f->current[slot] = NO_BATTLE;
+        pthread_mutex_unlock(&f->lock);
+    }
+}
+
+/* Forks a worker process into the given slot. A fork which fails, such as
+ * when the process limit is reached, is retried a few times with a growing
+ * wait in between, in case other processes exit meanwhile.
+ *
+ * @return its process id, or -1 if it could not be started */
+static pid_t spawn(farm* f, unsigned int slot, battle_fn play, void* context) {
+    long backoff = SPAWN_BACKOFF_NS;
+
+    for(unsigned int attempt=0; attempt<SPAWN_ATTEMPTS; attempt++) {
+        pid_t pid = fork();
+
+        if(pid == 0) {
+            work(f, slot, play, context);
+            _exit(0);
+        } else if(pid > 0) {
+            return pid;
+        }
+
+        struct timespec pause = { backoff / 1000000000, backoff % 1000000000 };
+        nanosleep(&pause, NULL);
+        backoff *= 2;
+    }
+
+    return -1;
+}
+
+/* Plays a batch of battles on a farm of worker processes. Workers take
+ * battles from a queue in shared memory and write their results to a table
+ * mapped into every process. Should a worker die while playing a battle, it
+ * is replaced, and the battle is queued once more; if it kills a worker a
+ * second time, it is given up on. Battles are only ever played in workers, so
+ * should no worker be left to play those still queued, because none could be
+ * forked, they are given up on too.
+ *
+ * @param battle_count - the number of battles, which are numbered from 0
+ * @param workers - the number of worker processes
+ * @param play - plays a battle, in a worker process
+ * @param context - passed to each call of play; the workers get a copy of
+ *        it, as of the call to run_farm
+ * @param results - filled with the result of each battle, or FARM_CRASHED or
+ *        FARM_UNPLAYED
+ * @return the number of workers which died */
+unsigned int run_farm(unsigned int battle_count, unsigned int workers,
+                      battle_fn play, void* context, int* results) {
+    unsigned int capacity = battle_count == 0 ? 1 : 2 * battle_count;
+    size_t size = sizeof(farm) + (2 * capacity + workers) * sizeof(unsigned int)
+                + battle_count * sizeof(int);
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if(memory == MAP_FAILED) {
+        for(unsigned int i=0; i<battle_count; i++) {
+            results[i] = FARM_UNPLAYED;
+        }
+
+        return 0;
+    }
+
+    farm* f = (farm*) memory;
+    pthread_mutexattr_t shared;
+
+    pthread_mutexattr_init(&shared);
+    pthread_mutexattr_setpshared(&shared, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&shared, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&f->lock, &shared);
+    pthread_mutexattr_destroy(&shared);
+
+    f->capacity = capacity;
+    f->head = 0;
+    f->tail = 0;
+    f->ring = (unsigned int*) (f + 1);
+    f->attempts = f->ring + capacity;
+    f->current = f->attempts + capacity;
+    f->results = (int*) (f->current + workers);
+
+    for(unsigned int i=0; i<battle_count; i++) {
+        f->attempts[i] = 0;
+        f->results[i] = FARM_UNPLAYED;
+        submit(f, i);
+    }
+
+    pid_t* pids = (pid_t*) malloc(workers * sizeof(pid_t));
+    unsigned int running = 0;
+    unsigned int deaths = 0;
+
+    for(unsigned int i=0; i<workers; i++) {
+        f->current[i] = NO_BATTLE;
+        pids[i] = spawn(f, i, play, context);
+        running += pids[i] > 0 ? 1 : 0;
+    }
+
+    while(running != 0) {
+        int status;
+        pid_t pid = wait(&status);
+        unsigned int slot = 0;
+
+        if(pid < 0) {
+            break;
+        }
+
+        while(slot < workers && pids[slot] != pid) {
+            slot++;
+        }
+
+        if(slot == workers) {
+            continue;
+        }
+
+        pids[slot] = -1;
+        running--;
+
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+
+        deaths++;
+
+        lock(f);
+
+        unsigned int battle = f->current[slot];
+        f->current[slot] = NO_BATTLE;
+
+        if(battle != NO_BATTLE && f->attempts[battle] < 2) {
+            submit(f, battle);
+        } else if(battle != NO_BATTLE) {
+            f->results[battle] = FARM_CRASHED;
+        }
+
+        bool queued = f->head != f->tail;
+        pthread_mutex_unlock(&f->lock);
+
+        if(queued) {
+            pids[slot] = spawn(f, slot, play, context);
+            running += pids[slot] > 0 ? 1 : 0;
+        }
+    }
+
+    memcpy(results, f->results, battle_count * sizeof(int));
+    pthread_mutex_destroy(&f->lock);
+    munmap(memory, size);
+    free(pids);
+
+    return deaths;
+}
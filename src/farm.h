@@ -0,0 +1,38 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_FARM_H_
+#define COREWARS_1984_FARM_H_
+
+/* The result run_farm() gives a battle whose worker died twice running it. */
+#define FARM_CRASHED (-2)
+
+/* The result run_farm() gives a battle left over when no worker process could
+ * be started to play it. */
+#define FARM_UNPLAYED (-3)
+
+/* Plays battle number battle of a farm, given the context of the farm, and
+ * returns its result, which must not be FARM_CRASHED or FARM_UNPLAYED. */
+typedef int (*battle_fn)(void* context, unsigned int battle);
+
+unsigned int run_farm(unsigned int battle_count, unsigned int workers,
+                      battle_fn play, void* context, int* results);
+
+#endif
@@ -0,0 +1,45 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_HASH_H_
+#define COREWARS_1984_HASH_H_
+
+#include <stdint.h>
+
+/* Scrambles a 64-bit key into a well-distributed 64-bit hash. This is the
+ * finalizer of the SplitMix64 generator. */
+static inline uint64_t mix64(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+
+    return key;
+}
+
+/* Returns the contribution of a core cell holding the given value to the hash
+ * of a whole core. A core hashes to the XOR of its cells, so a write can
+ * update the hash in constant time. */
+static inline uint64_t cell_hash(unsigned int index, uint32_t value) {
+    return mix64(((uint64_t) index << 32) | value);
+}
+
+#endif
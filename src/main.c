@@ -22,18 +22,30 @@ int main(int argc, char* argv[]) {
     }
 
     load_program(&m, &p, 0, 0);
-    printf("PC: %d\n", m.next_warrior->PC);
+    printf("PC: %d\n", m.warriors[m.next_warrior].PC);
 
     printf("\n MARS initial state:\n");
     print_block(&m, 0);
     print_block(&m, 1);
 
-    play(&m);
+    enable_cycle_detection(&m);
+    int winner = play(&m, NULL);
 
     printf("\n MARS final state:\n");
     print_block(&m, 0);
     print_block(&m, 1);
 
+    for(unsigned int i=0; i<m.event_count; i++) {
+        const death_event* event = get_event(&m, i);
+
+        if(event != NULL) {
+            printf("warrior %u died at %u on tick %u executing %08x\n",
+                   event->id, event->PC, event->tick, event->instruction);
+        }
+    }
+
+    printf("\nwinner: %d after %u ticks\n", winner, m.elapsed);
+
     destroy_program(&p);
     destroy_mars(&m);
 
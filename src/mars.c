@@ -19,12 +19,18 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "mars.h"
+#include "engine.h"
+#include "exec.h"
+#include "hash.h"
 #include "utils.h"
 
 /* Prints the hex values stored in each memory location of the mars in the given
@@ -41,13 +47,69 @@ void print_block(mars* m, unsigned int index) {
     }
 }
 
+/* @return the number of bytes in a core of the given number of cells */
+static size_t core_bytes(unsigned int cells) {
+    return sizeof(opcode) * cells;
+}
+
+/* Allocates an empty core of the given number of cells. Large cores are mapped
+ * straight from the kernel, so that reset_mars() can give their pages back. */
+static opcode* alloc_core(unsigned int cells) {
+    if(core_bytes(cells) >= LARGE_CORE_BYTES) {
+        void* core = mmap(NULL, core_bytes(cells), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        return core == MAP_FAILED ? NULL : (opcode*) core;
+    }
+
+    return (opcode*) calloc(cells, sizeof(opcode));
+}
+
+/* Frees a core allocated by alloc_core() with the given number of cells. */
+static void free_core(opcode* core, unsigned int cells) {
+    if(core_bytes(cells) >= LARGE_CORE_BYTES) {
+        munmap(core, core_bytes(cells));
+    } else {
+        free(core);
+    }
+}
+
+/* @return the number of dirty chunks tracked for a core of the given size */
+static unsigned int dirty_chunks(unsigned int core_size) {
+    return (core_size + DIRTY_CHUNK - 1) / DIRTY_CHUNK;
+}
+
 /* Deallocates dynamically allocated memory held by the given mars to prevent
  * memory leaks. This function must be called before a mars falls out of
  * scope or is freed.
  *
  * @param m - the mars to clean up */
 void destroy_mars(mars* m) {
-    free(m->core);
+    free(m->warriors);
+    free(m->events);
+    free_core(m->core, m->core_size);
+    free(m->decoded);
+    free(m->blocks);
+    free(m->free_blocks);
+    free(m->dirty);
+
+    if(m->fields != NULL) {
+        free(m->fields->type);
+        free(m->fields->a_mode);
+        free(m->fields->b_mode);
+        free(m->fields->a);
+        free(m->fields->b);
+        free(m->fields);
+    }
+}
+
+/* Marks every block of the given mars free, listing them in order. */
+static void free_all_blocks(mars* m) {
+    m->free_count = m->core_size / m->block_size;
+
+    for(unsigned int i=0; i<m->free_count; i++) {
+        m->free_blocks[i] = i;
+    }
 }
 
 /* Initializes a new, empty Memory Array Redcode Simulator (MARS) with the given
@@ -65,60 +127,365 @@ mars create_mars(unsigned int core_size, unsigned int block_size, unsigned int d
     m.duration = duration;
     m.elapsed = 0;
     m.alive_count = 0;
-    m.next_warrior = NULL;
-    m.core = (opcode*) malloc(sizeof(opcode) * core_size);
-    m.blocks = (bool*) malloc(sizeof(bool) * core_size / block_size);
+    m.warrior_count = 0;
+    m.next_warrior = NO_WARRIOR;
+    m.warriors = malloc(MAX_WARRIORS * sizeof(warrior));
+    m.events = malloc(EVENT_LOG_SIZE * sizeof(death_event));
+    m.event_count = 0;
+    m.result = NULL;
+    m.engine = select_engine(core_size);
+    m.core = alloc_core(core_size);
+    m.write_barrier = 0;
+    m.core_hash = 0;
+    m.stop_at = 0;
+    m.stop_reason = STOP_LIMIT;
+    m.watch = NO_ADDRESS;
+    m.breakpoint = NO_ADDRESS;
+    m.decoded = (predecoded*) malloc(sizeof(predecoded) * core_size);
+    m.fields = NULL;
+    m.blocks = (bool*) calloc(core_size / block_size, sizeof(bool));
+    m.free_blocks = (unsigned int*) malloc(sizeof(unsigned int) * (core_size / block_size));
+    free_all_blocks(&m);
+    m.dirty = (uint8_t*) calloc(dirty_chunks(core_size), sizeof(uint8_t));
+    m.seed = 0;
+    m.rng = 0;
+    m.seeded = false;
 
-    memset(m.core, 0, sizeof(opcode) * core_size);
-    memset(m.blocks, 0, sizeof(bool) * core_size / block_size);
+    for(unsigned int i=0; i<core_size; i++) {
+        predecode(&m, i);
+    }
+
+    memset(m.dirty, 0, dirty_chunks(core_size));
 
     return m;
 }
 
-/* Inserts the given warrior into the mars warrior list, so that it will take
- * turns executing instructions on the mars. The warrior is inserted after the
- * next warrior to take its turn, and becomes the next warrior to run. The mars
- * warrior counter is also incremented.
+/* Zeroes the cells of the given mars' core from first up to but not including
+ * last. Whole pages of a large core are given back to the kernel, which maps
+ * them to zero pages again, rather than cleared. */
+static void clear_cells(mars* m, unsigned int first, unsigned int last) {
+    char* begin = (char*) &m->core[first];
+    char* end = (char*) &m->core[last];
+
+#ifdef MADV_DONTNEED
+    if(core_bytes(m->core_size) >= LARGE_CORE_BYTES) {
+        uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+        char* low = (char*) (((uintptr_t) begin + page - 1) & ~(page - 1));
+        char* high = (char*) ((uintptr_t) end & ~(page - 1));
+
+        if(low < high && madvise(low, (size_t) (high - low), MADV_DONTNEED) == 0) {
+            memset(begin, 0, (size_t) (low - begin));
+            memset(high, 0, (size_t) (end - high));
+            return;
+        }
+    }
+#endif
+
+    memset(begin, 0, (size_t) (end - begin));
+}
+
+/* Seeds the random number generator the given mars places warriors with, so
+ * that get_block() and get_offset() give the same placements again. A mars
+ * which was never seeded is seeded from /dev/urandom when it first places a
+ * warrior, so that mars whose seed is set straight away never read it.
+ *
+ * @param m - the mars to seed
+ * @param seed - any number, which is kept in m->seed */
+void seed_mars(mars* m, uint64_t seed) {
+    m->seed = seed;
+    m->rng = seed;
+    m->seeded = true;
+}
+
+/* @return the generator of the given mars, seeded from /dev/urandom first if
+ *         it never was */
+static uint64_t* placement_rng(mars* m) {
+    if(!m->seeded) {
+        seed_mars(m, random_seed());
+    }
+
+    return &m->rng;
+}
+
+/* Empties the given mars for another battle, leaving it as create_mars() would
+ * but for its engine and any views of the core it was given, such as split
+ * fields, which it keeps. Cycle detection and hooks are turned off, and a seeded
+ * mars is seeded again with the next number from its own generator, so a
+ * pooled mars repeats its battles' placements if it is first given the same
+ * seed. Only the chunks of the core written since it was last empty are
+ * cleared, so a short battle on a large core is cheap to reset. Cells written
+ * directly rather than by the simulator are only cleared if predecode() was
+ * called on them.
+ *
+ * @param m - the mars to empty */
+void reset_mars(mars* m) {
+    unsigned int chunks = dirty_chunks(m->core_size);
+
+    m->write_barrier &= ~(unsigned int) (BARRIER_HASH | BARRIER_HOOKS);
+    m->core_hash = 0;
+
+    for(unsigned int chunk=0; chunk<chunks; chunk++) {
+        if(!m->dirty[chunk]) {
+            continue;
+        }
+
+        // clear each run of dirty chunks at once, so that large cores can give
+        // back the whole pages it covers
+        unsigned int first = chunk * DIRTY_CHUNK;
+
+        while(chunk < chunks && m->dirty[chunk]) {
+            m->dirty[chunk++] = 0;
+        }
+
+        unsigned int last = chunk * DIRTY_CHUNK < m->core_size ? chunk * DIRTY_CHUNK : m->core_size;
+
+        clear_cells(m, first, last);
+
+        for(unsigned int i=first; i<last; i++) {
+            predecode(m, i);
+        }
+    }
+
+    // predecode() marks the cells it refreshes as dirty
+    memset(m->dirty, 0, chunks);
+
+    memset(m->blocks, 0, sizeof(bool) * m->core_size / m->block_size);
+    free_all_blocks(m);
+    m->elapsed = 0;
+    m->alive_count = 0;
+    m->warrior_count = 0;
+    m->next_warrior = NO_WARRIOR;
+    m->event_count = 0;
+    m->result = NULL;
+    m->stop_at = 0;
+    m->stop_reason = STOP_LIMIT;
+    m->watch = NO_ADDRESS;
+    m->breakpoint = NO_ADDRESS;
+
+    if(m->seeded) {
+        seed_mars(m, rng_next(&m->rng));
+    }
+}
+
+/* Creates an empty pool of mars of the given size. The arguments are those of
+ * create_mars(). */
+mars_pool create_pool(unsigned int core_size, unsigned int block_size, unsigned int duration) {
+    mars_pool pool;
+
+    pool.core_size = core_size;
+    pool.block_size = block_size;
+    pool.duration = duration;
+    pool.count = 0;
+
+    return pool;
+}
+
+/* Hands out an empty mars from the given pool, creating one if the pool has
+ * none idle. The mars must be given back with release_mars().
+ *
+ * @return an empty mars of the pool's size */
+mars* acquire_mars(mars_pool* pool) {
+    if(pool->count != 0) {
+        return pool->idle[--pool->count];
+    }
+
+    mars* m = (mars*) malloc(sizeof(mars));
+    *m = create_mars(pool->core_size, pool->block_size, pool->duration);
+
+    return m;
+}
+
+/* Gives a mars from acquire_mars() back to its pool, which empties it with
+ * reset_mars() for the next battle, or destroys it if the pool is full. */
+void release_mars(mars_pool* pool, mars* m) {
+    if(pool->count == MARS_POOL_SIZE) {
+        destroy_mars(m);
+        free(m);
+        return;
+    }
+
+    reset_mars(m);
+    pool->idle[pool->count++] = m;
+}
+
+/* Destroys the idle mars of the given pool. */
+void destroy_pool(mars_pool* pool) {
+    while(pool->count != 0) {
+        mars* m = pool->idle[--pool->count];
+
+        destroy_mars(m);
+        free(m);
+    }
+}
+
+/* Refreshes the predecoded entry for the given core cell from its current
+ * contents. This must be called whenever m->core[index] is written. The value
+ * the cell held before is not known here, so the hash kept for cycle detection
+ * is left as it is; enable_cycle_detection() must be called again after
+ * writing to the core directly.
+ *
+ * @param m - the mars whose core cell changed
+ * @param index - the address of the cell to decode */
+void predecode(mars* m, unsigned int index) {
+    m->dirty[index / DIRTY_CHUNK] = 1;
+    decode_cell(m, index, m->core_size);
+    sync_cell(m, index, m->core[index]);
+
+    // fetch() refreshes the breakpoint cell, which is kept stale on purpose,
+    // just before a warrior executes it
+    if((m->write_barrier & BARRIER_HOOKS) && index == m->breakpoint) {
+        m->stop_reason = STOP_BREAKPOINT;
+        m->stop_at = 0;
+    }
+}
+
+/* Copies a cell into the per-field arrays of the core. */
+static void split_cell(mars* m, unsigned int index) {
+    core_fields* f = m->fields;
+    opcode op = m->core[index];
+
+    f->type[index] = (uint8_t) ((op & OP_TYPE_MASK) >> TYPE_OFFSET);
+    f->a_mode[index] = (uint8_t) ((op & A_MODE_MASK) >> A_MODE_OFFSET);
+    f->b_mode[index] = (uint8_t) ((op & B_MODE_MASK) >> B_MODE_OFFSET);
+    f->a[index] = (uint16_t) ((op & A_MASK) >> A_OFFSET);
+    f->b[index] = (uint16_t) ((op & B_MASK) >> B_OFFSET);
+}
+
+/* Marks the predecoded entry of the breakpoint cell stale, so that fetch()
+ * calls predecode() when a warrior reaches it. */
+static void arm_breakpoint(mars* m) {
+    m->decoded[m->breakpoint].raw = ~m->core[m->breakpoint];
+}
+
+/* Applies the hooks of run_cycles() to a cell that has just been written. */
+static void check_hooks(mars* m, unsigned int index) {
+    if(index == m->watch) {
+        m->stop_reason = STOP_WATCH;
+        m->stop_at = 0;
+    }
+
+    if(index == m->breakpoint) {
+        arm_breakpoint(m);
+    }
+}
+
+/* Brings the optional views of the core selected by m->write_barrier up to
+ * date with a cell that has just been written. store() calls this for every
+ * write when any view is enabled.
+ *
+ * @param m - the mars whose core cell changed
+ * @param index - the address of the cell
+ * @param old - the value the cell held before the write */
+void sync_cell(mars* m, unsigned int index, opcode old) {
+    if(m->write_barrier & BARRIER_HASH) {
+        m->core_hash ^= cell_hash(index, old) ^ cell_hash(index, m->core[index]);
+    }
+
+    if(m->write_barrier & BARRIER_CORE_FIELDS) {
+        split_cell(m, index);
+    }
+
+    if(m->write_barrier & BARRIER_HOOKS) {
+        check_hooks(m, index);
+    }
+}
+
+/* Allocates an array of the given number of elements, aligned and padded to
+ * FIELD_ALIGNMENT bytes so that vector scans may read whole blocks. */
+static void* alloc_field(unsigned int count, size_t element_size) {
+    size_t bytes = count * element_size;
+    bytes = (bytes + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+
+    void* field = aligned_alloc(FIELD_ALIGNMENT, bytes);
+    memset(field, 0, bytes);
+
+    return field;
+}
+
+/* Gives the given mars a second, struct-of-arrays copy of its core, holding
+ * each instruction field in its own aligned array. The simulator keeps the
+ * arrays in sync with the core, so scans such as those in scan.h can use them
+ * without decoding opcodes. Code writing the core directly must call
+ * predecode() on the cells it changes.
+ *
+ * @param m - the mars whose core should be split */
+void enable_core_fields(mars* m) {
+    if(m->fields != NULL) {
+        return;
+    }
+
+    m->fields = (core_fields*) malloc(sizeof(core_fields));
+    m->fields->type = (uint8_t*) alloc_field(m->core_size, sizeof(uint8_t));
+    m->fields->a_mode = (uint8_t*) alloc_field(m->core_size, sizeof(uint8_t));
+    m->fields->b_mode = (uint8_t*) alloc_field(m->core_size, sizeof(uint8_t));
+    m->fields->a = (uint16_t*) alloc_field(m->core_size, sizeof(uint16_t));
+    m->fields->b = (uint16_t*) alloc_field(m->core_size, sizeof(uint16_t));
+    m->write_barrier |= BARRIER_CORE_FIELDS;
+
+    for(unsigned int i=0; i<m->core_size; i++) {
+        split_cell(m, i);
+    }
+}
+
+/* Adds a warrior to the warrior array of the mars, so that it will take turns
+ * executing instructions on the mars. The warrior takes its turn after the
+ * next warrior to run, and becomes the next warrior to run. The mars warrior
+ * counter is also incremented.
  *
  * @param m - the mars to which the warrior is being added
- * @param w - the warrior to add to the mars */
-void insert_warrior(mars* m, warrior* w) {
-    if(m->next_warrior == NULL) {
-        w->next = w;
-        w->prev = w;
+ * @param id - the id of the new warrior
+ * @param pc - the address of the new warrior's first instruction
+ * @return the index of the new warrior in m->warriors, or NO_WARRIOR if the
+ *         mars already holds MAX_WARRIORS warriors */
+unsigned int insert_warrior(mars* m, unsigned int id, unsigned int pc) {
+    if(m->warrior_count == MAX_WARRIORS) {
+        return NO_WARRIOR;
+    }
+
+    unsigned int index = m->warrior_count++;
+    warrior* w = &m->warriors[index];
+
+    w->id = id;
+    w->PC = pc;
+
+    if(m->next_warrior == NO_WARRIOR) {
+        w->next = index;
+        w->prev = index;
     } else {
         // circular doubly-linked list insert
-        warrior* prev = m->next_warrior;
-        warrior* next = prev->next;
+        unsigned int prev = m->next_warrior;
+        unsigned int next = m->warriors[prev].next;
 
-        prev->next = w;
+        m->warriors[prev].next = index;
         w->prev = prev;
-        next->prev = w;
+        m->warriors[next].prev = index;
         w->next = next;
     }
 
-    m->next_warrior = w;
+    m->next_warrior = index;
     (m->alive_count)++;
+
+    return index;
 }
 
-/* Removes the given warrior into the mars warrior list, so that it will no
- * longer take turns executing instructions on the mars. If the warrior to be
- * removed is currently the next to run on the mars, the next to run will change
- * to the one after. The mars warrior counter is also decremented.
+/* Removes the given warrior from the turn order of the mars, so that it will
+ * no longer take turns executing instructions on the mars. The other warriors
+ * keep their order. If the warrior to be removed is currently the next to run
+ * on the mars, the next to run will change to the one after. The mars warrior
+ * counter is also decremented.
  *
  * @param m - the mars from which the warrior is being removed
- * @param w - the warrior to remove from the mars */
-void remove_warrior(mars* m, warrior* w) {
-    warrior* prev = w->prev;
-    warrior* next = w->next;
-    prev->next = next;
-    next->prev = prev;
+ * @param index - the index of the warrior to remove in m->warriors */
+void remove_warrior(mars* m, unsigned int index) {
+    warrior* w = &m->warriors[index];
+    m->warriors[w->prev].next = w->next;
+    m->warriors[w->next].prev = w->prev;
 
     // the removed warrior cannot be the next to run!
-    if(m->next_warrior == w) {
+    if(m->next_warrior == index) {
         // corner case: w is the only warrior in the mars
         if(m->alive_count == 1) {
-            m->next_warrior = NULL;
+            m->next_warrior = NO_WARRIOR;
         } else {
             m->next_warrior = w->next;
         }
@@ -130,72 +497,165 @@ void remove_warrior(mars* m, warrior* w) {
 /* Creates a new warrior in the given mars, starting with the code of the given
  * program. Note that the given block must be free--this method does not check
  * whether it is free, and will overwrite another program that is loaded there.
- * Offset must also be less than m->block_size - prog.size
+ * Offset must also be less than m->block_size - prog.size. Programs which would
+ * not fit in the core at the given place, or are longer than MAX_PROGRAM_SIZE,
+ * are refused rather than written out of bounds.
  *
  * @param m - the mars to which the new warrior should be added
  * @param prog - a program with the original code for the new warrior
  * @param block - the block number in the mars into which to load code
  * @param offset - the offset within the given block at which to load code
- * @return the newly created warrior, which has been loaded into m */
-warrior load_program(mars* m, program* prog, unsigned int block, unsigned int offset) {
-    warrior w;
-    w.id = prog->id;
+ * @return the index in m->warriors of the newly created warrior, or NO_WARRIOR
+ *         if the mars is full or the program does not fit */
+unsigned int load_program(mars* m, program* prog, unsigned int block, unsigned int offset) {
+    uint64_t end = (uint64_t) m->block_size * block + offset + prog->size;
 
-    insert_warrior(m, &w);
+    if(prog->size > MAX_PROGRAM_SIZE || end > m->core_size) {
+        return NO_WARRIOR;
+    }
 
     // load program into mars memory
     unsigned int base = m->block_size * block + offset;
-    w.PC = base;
+    unsigned int index = insert_warrior(m, prog->id, base);
+
+    if(index == NO_WARRIOR) {
+        return NO_WARRIOR;
+    }
 
     for(unsigned int i=0; i<prog->size; i++) {
-        m->core[base+i] = prog->code[i];
+        store(m, base+i, prog->code[i], m->core_size);
     }
 
-    return w;
+    return index;
 }
 
 /* Chooses a random, unoccupied block into which to load a program, marks
- * it as occupied, and returns its number. If the core is full, it will
- * return UINT_MAX. Note that this function will likely run slowly when a large
- * fraction of blocks are occupied. Since the returned block is guaranteed to be
- * unoccupied, the return value of this function is safe to pass
- * into load_program.
+ * it as occupied, and returns its number. Blocks are drawn from the mars'
+ * generator, so they depend only on its seed. If the core is full, it will
+ * return UINT_MAX. The free blocks are kept in a list, from which the chosen
+ * one is swapped out, so this takes constant time however full the core is.
+ * Since the returned block is guaranteed to be unoccupied, the return value of
+ * this function is safe to pass into load_program.
  *
  * @return index of a free block in the given mars */
 unsigned int get_block(mars* m) {
-    // if core is full, return -1
-    bool full = true;
+    if(m->free_count == 0) {
+        return UINT_MAX;
+    }
+
+    unsigned int slot = rng_below(placement_rng(m), m->free_count);
+    unsigned int block = m->free_blocks[slot];
+
+    m->free_blocks[slot] = m->free_blocks[--m->free_count];
+    m->blocks[block] = true;
+
+    return block;
+}
 
-    for(unsigned int i=0; i<(m->core_size / m->block_size); i++) {
-      if(!m->blocks[i]) {
-        full = false;
-        break;
-      }
+/* Chooses count distinct random blocks at once, as get_block() would one at a
+ * time.
+ *
+ * @param m - the mars in which to choose blocks
+ * @param count - the number of blocks wanted
+ * @param blocks - filled with the chosen blocks
+ * @return the number of blocks chosen, which is less than count only if the
+ *         core ran out of free blocks */
+unsigned int get_blocks(mars* m, unsigned int count, unsigned int* blocks) {
+    unsigned int chosen = 0;
+
+    while(chosen < count && m->free_count != 0) {
+        blocks[chosen++] = get_block(m);
     }
 
-    if(full) {
-      return UINT_MAX;
+    return chosen;
+}
+
+/* Marks a block chosen by get_block() free again, so that it may be chosen
+ * once more. Freeing a block which is already free does nothing.
+ *
+ * @param m - the mars to which the block belongs
+ * @param block - the block to free */
+void release_block(mars* m, unsigned int block) {
+    if(!m->blocks[block]) {
+        return;
     }
 
-    // pick a random free block
-    unsigned int block;
+    m->blocks[block] = false;
+    m->free_blocks[m->free_count++] = block;
+}
+
+/* Loads each of the given programs into a random free block of the mars, at a
+ * random offset, in order, so that the last program moves first. This is how
+ * a melee of many warriors is set up.
+ *
+ * @param m - the mars into which to load the programs
+ * @param programs - the programs to load
+ * @param count - the number of programs
+ * @return the number of programs loaded, which is less than count only if the
+ *         core ran out of free blocks or a program did not fit in one, in which
+ *         case the programs after it are not loaded */
+unsigned int place_programs(mars* m, program* programs, unsigned int count) {
+    for(unsigned int i=0; i<count; i++) {
+        unsigned int block = get_block(m);
 
-    do {
-        block = randuint() % (m->core_size / m->block_size + 1);
-    } while(m->blocks[block]);
+        if(block == UINT_MAX) {
+            return i;
+        }
 
-    m->blocks[block] = true;
+        if(load_program(m, &programs[i], block, get_offset(m, &programs[i])) == NO_WARRIOR) {
+            release_block(m, block);
+            return i;
+        }
+    }
 
-    return block;
+    return count;
 }
 
 /* Chooses a random offset within a block such that the program fits between
  * block_base + offset and block_base + block_size. The return value of this
  * function is safe to pass into load_program.
  *
- * @return safe offset for the given program within a block */
+ * @return safe offset for the given program within a block, or UINT_MAX if
+ *         the program is longer than a block, which load_program refuses */
 unsigned int get_offset(mars* m, program* prog) {
-    return randuint() % (unsigned int)(m->block_size - prog->size + 1);
+    if(prog->size > m->block_size) {
+        return UINT_MAX;
+    }
+
+    return rng_below(placement_rng(m), (unsigned int)(m->block_size - prog->size + 1));
+}
+
+/* Returns the value of an operand whose fields have already been decoded.
+ * The target is the address of the instruction plus the operand value,
+ * already wrapped to the core, as stored in a predecoded entry. If the mode is
+ * invalid, INT_MAX is returned instead. */
+static inline int operand_value(mars* m, int index, unsigned int mode,
+                                int value, unsigned int target) {
+    switch (mode) {
+        case IMMEDIATE_MODE:
+            return value;
+        case RELATIVE_MODE:
+            return (int) m->core[target];
+        case INDIRECT_MODE:
+            value = (int) m->core[target];
+            return (int) m->core[wrap_index(index+value, m->core_size)];
+        default:
+            return INT_MAX;
+    }
+}
+
+/* Returns the core address refered to by an operand whose fields have already
+ * been decoded, or INT_MAX if the mode does not give a valid address. */
+static inline int operand_address(mars* m, int index, unsigned int mode,
+                                  unsigned int target) {
+    switch (mode) {
+        case RELATIVE_MODE:
+            return (int) target;
+        case INDIRECT_MODE:
+            return wrap_index(index + (int) m->core[target], m->core_size);
+        default:
+            return INT_MAX;
+    }
 }
 
 /* Returns as a signed int the value of an operand from an instruction at the
@@ -210,22 +670,9 @@ unsigned int get_offset(mars* m, program* prog) {
 int get_operand_value(mars* m, int index, unsigned int mode,
                       unsigned int raw_value) {
     int value = get_signed_operand_value(raw_value);
+    int target = wrap_index(index + value, m->core_size);
 
-    switch (mode) {
-        case IMMEDIATE_MODE:
-            return value;
-        case RELATIVE_MODE:
-            raw_value = m->core[wrap_index(index+value, m->core_size)];
-            return (int) raw_value;
-        case INDIRECT_MODE:
-            raw_value = m->core[wrap_index(index+value, m->core_size)];
-            value = (int) raw_value;
-            raw_value = m->core[wrap_index(index+value, m->core_size)];
-            return (int) raw_value;
-        default:
-            printf("died: invalid addressing mode\n");
-            return INT_MAX;
-    }
+    return operand_value(m, index, mode, value, (unsigned int) target);
 }
 
 /* Compute the address refered to by an operand in the designated addressing
@@ -240,85 +687,389 @@ int get_operand_value(mars* m, int index, unsigned int mode,
 int get_operand_address(mars* m, int index, unsigned int mode,
                         unsigned int raw_value) {
     int value = get_signed_operand_value(raw_value);
-    int addr = wrap_index(index + value, m->core_size);
+    int target = wrap_index(index + value, m->core_size);
 
-    switch (mode) {
-        case RELATIVE_MODE:
-            return addr;
-        case INDIRECT_MODE:
-            value = (int) m->core[addr];
-            return wrap_index(index + value, m->core_size);
-        default:
-            return INT_MAX;
+    return operand_address(m, index, mode, (unsigned int) target);
+}
+
+/* Removes a warrior that executed an illegal instruction from the mars, and
+ * records its death in the event log of the mars and in the result of the
+ * battle being played, if any. Nothing is printed, so that batch runs keep
+ * their output clean. The
+ * warrior must be the next to run, so its turn passes to the one after it.
+ *
+ * @param m - the mars the warrior is running on
+ * @param index - the index of the warrior that died in m->warriors */
+void kill_warrior(mars* m, unsigned int index) {
+    warrior* w = &m->warriors[index];
+    death_event* event = &m->events[m->event_count % EVENT_LOG_SIZE];
+
+    event->id = w->id;
+    event->PC = w->PC;
+    event->tick = m->elapsed;
+    event->instruction = m->core[w->PC];
+    m->event_count++;
+
+    battle_result* result = m->result;
+
+    if(result != NULL && result->death_count < MAX_WARRIORS) {
+        result->death_ids[result->death_count] = w->id;
+        result->death_ticks[result->death_count] = m->elapsed;
+        result->death_count++;
+    }
+
+    remove_warrior(m, index);
+}
+
+/* Returns the nth death recorded in the event log of the given mars, counting
+ * from 0 for the first death since the mars was created. The log keeps only
+ * the last EVENT_LOG_SIZE deaths, so older ones are no longer available.
+ *
+ * @param m - the mars whose log to read
+ * @param n - the number of the death, less than m->event_count
+ * @return the recorded death, or NULL if it is not in the log */
+const death_event* get_event(mars* m, unsigned int n) {
+    if(n >= m->event_count || m->event_count - n > EVENT_LOG_SIZE) {
+        return NULL;
     }
+
+    return &m->events[n % EVENT_LOG_SIZE];
 }
 
-/* Executes the next instruction for the given program. */
+/* Executes the next instruction for the given program, dispatching on its
+ * type and modes through the handler table of the mars' engine. A warrior that
+ * executes an illegal instruction is removed from the mars. */
 void tick(mars* m) {
-    warrior* prog = m->next_warrior; // does this fix it?
+    warrior* prog = &m->warriors[m->next_warrior];
+    const predecoded* instr = fetch(m, prog->PC);
+    const handler* handlers = m->engine->handlers;
+    unsigned int pc = handlers[HANDLER_INDEX(instr->raw)](m, prog->PC, instr);
 
-    int addr = (int) prog->PC;
-    instruction instr = decode(m->core[addr]);
-    //printf("addr: %d, value: %x\n", addr, m->core[addr]);
+    if(pc == DIED) {
+        kill_warrior(m, m->next_warrior);
+    } else {
+        prog->PC = pc;
+        m->next_warrior = prog->next;
+    }
 
-    int a = get_operand_value(m, addr, instr.a_mode, instr.a);
-    int b = get_operand_value(m, addr, instr.b_mode, instr.b);
-    int b_addr = get_operand_address(m, addr, instr.b_mode, instr.b);
+    m->elapsed++;
+}
 
-    switch (instr.type) {
-        case MOV_TYPE:
-            //printf("MOV\n");
-            m->core[b_addr] = (opcode) a;
-            break;
-        case ADD_TYPE:
-            //printf("ADD\n");
-            // Do normal unsigned int addition. No wrap on operand boundaries.
-            m->core[b_addr] = (opcode) ((int) m->core[b_addr] + a);
-            break;
-        case SUB_TYPE:
-            //printf("SUB\n");
-            // Do normal unsigned int addition. No wrap on operand boundaries.
-            m->core[b_addr] = (opcode) ((int) m->core[b_addr] - a);
-            break;
-        case JMP_TYPE:
-            //printf("JMP\n");
-            prog->PC = (unsigned int) (b_addr - 1) % m->core_size;
-            break;
-        case JMZ_TYPE:
-            //printf("JMZ\n");
-            if(a == 0)
-                prog->PC = (unsigned int) (b_addr - 1) % m->core_size;
-            break;
-        case DJZ_TYPE:
-            //printf("DJZ\n");
-            if(--a == 0)
-                prog->PC = (unsigned int) (b_addr - 1) % m->core_size;
-            break;
-        case CMP_TYPE:
-            if(a != b)
-                prog->PC = (prog->PC + 1) % m->core_size;
-            break;
-        default:
-            printf("uh oh... %d\n", instr.type);
-            printf("type: %x modeA: %x modeB: %x opA: %x opB: %x\n", instr.type, instr.a_mode, instr.b_mode, instr.a, instr.b);
-            printf("addr %d invalid instruction: %x\n", addr, m->core[addr]);
+/* Starts the sampling of battle states over, e.g. after a death changed the
+ * set of warriors and with it the length of a round. */
+static void restart_cycle_detection(mars* m) {
+    m->cycle_next = m->elapsed + CYCLE_CHECK_ROUNDS * m->alive_count;
+    m->cycle_steps = 0;
+    m->cycle_power = 1;
+    m->cycle_mark = state_hash(m);
+}
 
-            remove_warrior(m, prog);
+/* Turns on detection of repeated states for the given mars. play() and
+ * play_fast() will then sample a hash of the whole machine state every
+ * CYCLE_CHECK_ROUNDS rounds, and end the battle as a draw if a sample repeats,
+ * since a deterministic machine that returns to a state loops forever. The
+ * hash of the core is updated on each write, and the other parts of the state
+ * are only hashed when sampled.
+ *
+ * Samples are checked with Brent's algorithm, which keeps a single earlier
+ * sample and doubles the distance to it, so a repeat is found within about
+ * twice the length of the loop without keeping a table of past states. As
+ * only hashes are compared, a collision could end a battle early, though with
+ * 64-bit hashes that is vanishingly unlikely.
+ *
+ * @param m - the mars to watch for repeated states */
+void enable_cycle_detection(mars* m) {
+    m->core_hash = 0;
+
+    for(unsigned int i=0; i<m->core_size; i++) {
+        m->core_hash ^= cell_hash(i, m->core[i]);
     }
 
-    prog->PC = (prog->PC + 1) % m->core_size;
-    m->next_warrior = m->next_warrior->next;
-    m->elapsed++;
+    m->write_barrier |= BARRIER_HASH;
+    restart_cycle_detection(m);
+}
+
+/* Returns a hash of the full state of the given mars: its core, the PC of each
+ * live warrior and which warrior runs next. Warriors are hashed in turn order
+ * starting from the next to run, which captures both. The core must be
+ * hashed, i.e. cycle detection must be enabled.
+ *
+ * @param m - the mars to hash
+ * @return a hash which is equal for equal states */
+uint64_t state_hash(mars* m) {
+    uint64_t hash = m->core_hash;
+    unsigned int w = m->next_warrior;
+
+    for(unsigned int i=0; i<m->alive_count; i++) {
+        hash ^= mix64(((uint64_t) (i + 1) << 32) | m->warriors[w].PC);
+        w = m->warriors[w].next;
+    }
+
+    return hash;
+}
+
+/* Samples the state of a mars with cycle detection at a check point.
+ *
+ * @return whether the state has been seen before */
+static bool sample_state(mars* m) {
+    uint64_t hash = state_hash(m);
+
+    if(hash == m->cycle_mark) {
+        return true;
+    }
+
+    m->cycle_steps++;
+
+    if(m->cycle_steps == m->cycle_power) {
+        m->cycle_mark = hash;
+        m->cycle_power *= 2;
+        m->cycle_steps = 0;
+    }
+
+    m->cycle_next = m->elapsed + CYCLE_CHECK_ROUNDS * m->alive_count;
+
+    return false;
+}
+
+/* Prepares the given result record for a battle about to be played. */
+static void begin_battle(mars* m, battle_result* result) {
+    if(result != NULL) {
+        result->death_count = 0;
+        result->repeated = false;
+        result->seed = m->seed;
+    }
+
+    m->result = result;
+
+    if(m->write_barrier & BARRIER_HASH) {
+        restart_cycle_detection(m);
+    }
+}
+
+/* Finishes the result record of a battle that has just ended. A lone warrior
+ * wins whether or not cycle detection cut its battle short, just as it would
+ * by reaching the duration.
+ *
+ * @return the id of the winning warrior, or -1 for a draw */
+static int end_battle(mars* m, bool repeated) {
+    int winner = -1;
+
+    if(m->alive_count == 1) {
+        winner = (int) m->warriors[m->next_warrior].id;
+    }
+
+    if(m->result != NULL) {
+        m->result->winner = winner;
+        m->result->repeated = repeated;
+        m->result->elapsed = m->elapsed;
+    }
+
+    m->result = NULL;
+
+    return winner;
+}
+
+/* Returns whether every live warrior of the given mars is about to execute an
+ * imp. */
+static bool only_imps(mars* m) {
+    unsigned int w = m->next_warrior;
+
+    for(unsigned int i=0; i<m->alive_count; i++) {
+        if(m->core[m->warriors[w].PC] != IMP_OPCODE) {
+            return false;
+        }
+
+        w = m->warriors[w].next;
+    }
+
+    return true;
+}
+
+/* Runs a battle in which only imps are left up to the given tick at once. An
+ * imp copies itself one cell ahead and follows the copy, so imps stay imps
+ * and nobody dies whatever cells they cross: each warrior ends up as many
+ * cells ahead as it had turns, having left imps in the cells it passed. These
+ * are written in bulk through store(), skipping cells which already hold an
+ * imp, so at most one lap of the core is written per warrior.
+ *
+ * @param m - a mars for which only_imps() holds
+ * @param until - the tick to run to */
+static void skip_imps(mars* m, unsigned int until) {
+    unsigned int size = m->core_size;
+    unsigned int turns = until - m->elapsed;
+    unsigned int alive = m->alive_count;
+    unsigned int w = m->next_warrior;
+
+    for(unsigned int i=0; i<alive; i++) {
+        warrior* imp = &m->warriors[w];
+        unsigned int steps = turns / alive + (i < turns % alive ? 1 : 0);
+        unsigned int cells = steps < size ? steps : size;
+        unsigned int address = imp->PC;
+
+        for(unsigned int j=0; j<cells; j++) {
+            address = address + 1 == size ? 0 : address + 1;
+
+            if(m->core[address] != IMP_OPCODE) {
+                store(m, address, IMP_OPCODE, size);
+            }
+        }
+
+        imp->PC = (unsigned int) ((imp->PC + (uint64_t) steps) % size);
+        w = imp->next;
+
+        if(i + 1 == turns % alive) {
+            m->next_warrior = w;
+        }
+    }
+
+    m->elapsed = until;
+}
+
+/* Runs a battle in stretches which end at each death and at the points where
+ * cycle detection, if it is on, samples the state. Each stretch is run by the
+ * engine's threaded loop if fast is set, or by tick() otherwise; either way
+ * they stop at the same points, so both give identical results. Stretches
+ * are also cut every IMP_CHECK_ROUNDS rounds to look for a battle that only
+ * imps are left in, which skip_imps() then finishes in closed form.
+ *
+ * @return the id of the winning warrior, or -1 for a draw */
+static int run_battle(mars* m, battle_result* result, bool fast) {
+    unsigned int survivors = m->alive_count > 1 ? 1 : 0;
+    bool detect = (m->write_barrier & BARRIER_HASH) != 0;
+    bool repeated = false;
+
+    begin_battle(m, result);
+
+    while(m->elapsed < m->duration && m->alive_count > survivors) {
+        unsigned int until = m->duration;
+        unsigned int alive = m->alive_count;
+
+        if(detect && m->cycle_next < until) {
+            until = m->cycle_next;
+        }
+
+        if(only_imps(m)) {
+            skip_imps(m, until);
+        } else {
+            if(until - m->elapsed > IMP_CHECK_ROUNDS * alive) {
+                until = m->elapsed + IMP_CHECK_ROUNDS * alive;
+            }
+
+            if(fast) {
+                m->engine->run(m, until);
+            } else {
+                while(m->elapsed < until && m->alive_count == alive) {
+                    tick(m);
+                }
+            }
+        }
+
+        if(!detect || m->alive_count <= survivors) {
+            continue;
+        } else if(m->alive_count != alive) {
+            restart_cycle_detection(m);
+        } else if(m->elapsed == m->cycle_next && sample_state(m)) {
+            repeated = true;
+            break;
+        }
+    }
+
+    return end_battle(m, repeated);
 }
 
 /* Carries out gameplay on the given mars until the game duration is met or only
  * one program is still running. Returns the player_id of the winning program,
  * or -1 if there is a draw.
+ *
+ * @param m - the mars to play, with its warriors loaded
+ * @param result - filled with the outcome and deaths of the battle; may be NULL
+ * @return the id of the only surviving warrior, or -1 for a draw
+ */
+int play(mars* m, battle_result* result) {
+    return run_battle(m, result, false);
+}
+
+/* Carries out gameplay exactly like play(), but with the direct-threaded loop
+ * of the mars' engine in place of per-instruction calls to tick().
  */
-int play(mars* m) {
-    while(m->elapsed < m->duration && m->alive_count > 0) {
-      tick(m);
+int play_fast(mars* m, battle_result* result) {
+    return run_battle(m, result, true);
+}
+
+/* Runs up to n instructions on the given mars with the threaded loop of its
+ * engine, stopping early when a warrior dies, when the battle ends, or when
+ * one of the given hooks fires. This lets a caller advance a battle in large
+ * chunks while still reacting to the events it cares about. Hooks cost nothing
+ * while they do not fire: the watched address is checked only on writes to the
+ * core, and the breakpoint cell is kept stale so that only fetching it leaves
+ * the fast path. A warrior which is at the breakpoint when run_cycles() is
+ * called executes it, so that a stopped run can be resumed.
+ *
+ * The battle has ended once the duration is met, no warrior is alive, or a
+ * death has left a single warrior out of several.
+ *
+ * @param m - the mars to run
+ * @param n - the most instructions to execute
+ * @param hooks - the points at which to stop early; may be NULL
+ * @return one of the STOP_* reasons for stopping; the number of instructions
+ *         executed is the increase in m->elapsed
+ */
+unsigned int run_cycles(mars* m, unsigned int n, const run_hooks* hooks) {
+    if(m->elapsed >= m->duration || m->alive_count == 0) {
+        return STOP_END;
+    }
+
+    unsigned int alive = m->alive_count;
+    unsigned int until = m->duration;
+    unsigned int reason = STOP_END;
+
+    if(n < m->duration - m->elapsed) {
+        until = m->elapsed + n;
+        reason = STOP_LIMIT;
+    }
+
+    if(hooks != NULL && hooks->interval != 0) {
+        unsigned int next = (m->elapsed / hooks->interval + 1) * hooks->interval;
+
+        if(next > m->elapsed && next <= until) {
+            until = next;
+            reason = next == m->duration ? STOP_END : STOP_INTERVAL;
+        }
+    }
+
+    m->stop_reason = reason;
+
+    if(hooks != NULL && (hooks->watch != NO_ADDRESS || hooks->breakpoint != NO_ADDRESS)) {
+        m->watch = hooks->watch;
+        m->breakpoint = hooks->breakpoint;
+        m->write_barrier |= BARRIER_HOOKS;
+
+        if(m->breakpoint != NO_ADDRESS) {
+            if(m->warriors[m->next_warrior].PC == m->breakpoint && m->elapsed < until) {
+                tick(m);
+            }
+
+            arm_breakpoint(m);
+        }
+
+        if(m->alive_count == alive && m->stop_reason != STOP_WATCH && m->elapsed < until) {
+            m->engine->run(m, until);
+        }
+
+        if(m->breakpoint != NO_ADDRESS) {
+            m->decoded[m->breakpoint].raw = m->core[m->breakpoint];
+        }
+
+        m->write_barrier &= ~(unsigned int) BARRIER_HOOKS;
+        m->watch = NO_ADDRESS;
+        m->breakpoint = NO_ADDRESS;
+    } else {
+        m->engine->run(m, until);
+    }
+
+    if(m->alive_count != alive) {
+        return m->alive_count > 1 && m->elapsed < m->duration ? STOP_DEATH : STOP_END;
     }
 
-    return 0; // TODO: return index of winning program
+    return m->stop_reason;
 }
@@ -22,41 +22,212 @@
 #define COREWARS_1984_MARS_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "program.h"
 
+/* A warrior's record in the warrior array of its mars. The live warriors form
+ * a circular list in turn order, linked by their indices in the array. */
 typedef struct warrior {
     unsigned int id;
     unsigned int PC;
-    struct warrior* prev;
-    struct warrior* next;
+    unsigned int prev;
+    unsigned int next;
 } warrior;
 
+/* The most warriors a mars can hold, and whose deaths a battle_result can
+ * record. */
+#define MAX_WARRIORS 1024
+
+/* Stands for no warrior where a warrior index is expected. */
+#define NO_WARRIOR 0xFFFFFFFFu
+
+/* A warrior death, recorded in the event log of a mars: which warrior died,
+ * where, on which tick, and the illegal instruction that killed it. */
+typedef struct death_event {
+    unsigned int id;
+    unsigned int PC;
+    unsigned int tick;
+    opcode instruction;
+} death_event;
+
+/* The number of most recent deaths kept in the event log of a mars. This must
+ * be a power of two. */
+#define EVENT_LOG_SIZE 256
+
+/* Outcome of a battle run by play() or play_fast(). Deaths are listed in the
+ * order they happened; the tick of a death is the value of mars.elapsed when
+ * the warrior executed its fatal instruction. A battle is marked repeated if
+ * it was ended early because cycle detection saw the same state twice, which
+ * is a draw unless a single warrior was left running. The seed is that of the
+ * mars the battle was played on, from which its warriors were placed, or 0 if
+ * the mars was never seeded. */
+typedef struct battle_result {
+    int winner;
+    bool repeated;
+    uint64_t seed;
+    unsigned int elapsed;
+    unsigned int death_count;
+    unsigned int death_ids[MAX_WARRIORS];
+    unsigned int death_ticks[MAX_WARRIORS];
+} battle_result;
+
+/* A core cell unpacked ahead of time, so that tick() does not need to decode
+ * the executing instruction or recompute its relative addresses. The raw
+ * opcode is kept alongside so a stale entry can be detected cheaply. */
+typedef struct predecoded {
+    opcode raw;
+    uint8_t type;
+    uint8_t a_mode;
+    uint8_t b_mode;
+    int a;
+    int b;
+    unsigned int a_target;
+    unsigned int b_target;
+} predecoded;
+
+/* The core split into one aligned array per instruction field, so that tools
+ * scanning the whole core can do so without unpacking opcodes. Each array is
+ * aligned and padded to FIELD_ALIGNMENT bytes. */
+#define FIELD_ALIGNMENT 64
+
+typedef struct core_fields {
+    uint8_t* type;
+    uint8_t* a_mode;
+    uint8_t* b_mode;
+    uint16_t* a;
+    uint16_t* b;
+} core_fields;
+
+/* Bits of mars.write_barrier, set for each optional view of the core that
+ * must be updated whenever a cell is written. */
+#define BARRIER_CORE_FIELDS 0x1
+#define BARRIER_HASH 0x2
+#define BARRIER_HOOKS 0x4
+
+/* With cycle detection on, the state of a battle is sampled every this many
+ * rounds of turns. */
+#define CYCLE_CHECK_ROUNDS 64
+
+/* MOV 0 1, the imp. A battle in which every live warrior is about to execute
+ * one can only go on copying imps forward, so play() and play_fast() skip
+ * through it in closed form, checking for it every IMP_CHECK_ROUNDS rounds. */
+#define IMP_OPCODE 0x15000001u
+#define IMP_CHECK_ROUNDS 1024
+
+/* Writes to the core are tracked in chunks of this many cells, so that
+ * reset_mars() only has to clear the chunks written since the core was last
+ * empty. This must be a power of two. */
+#define DIRTY_CHUNK 64
+
+/* Cores of at least this many bytes are mapped straight from the kernel, so
+ * that reset_mars() can hand whole dirty pages back with madvise() instead of
+ * clearing them. */
+#define LARGE_CORE_BYTES (1 << 20)
+
+/* The most idle mars a mars_pool keeps for reuse. */
+#define MARS_POOL_SIZE 4
+
+/* Marks an address hook of run_hooks as unused. */
+#define NO_ADDRESS 0xFFFFFFFFu
+
+/* Points at which run_cycles() should stop early. The interval stops the run
+ * whenever mars.elapsed reaches a multiple of it; 0 disables it. The watched
+ * address stops the run after an instruction writes to it, and the breakpoint
+ * stops it before a warrior executes the instruction there. */
+typedef struct run_hooks {
+    unsigned int interval;
+    unsigned int watch;
+    unsigned int breakpoint;
+} run_hooks;
+
+/* Reasons returned by run_cycles() for stopping. */
+#define STOP_LIMIT 0
+#define STOP_DEATH 1
+#define STOP_END 2
+#define STOP_INTERVAL 3
+#define STOP_WATCH 4
+#define STOP_BREAKPOINT 5
+
+struct engine;
+
 typedef struct mars {
     unsigned int core_size;
     unsigned int block_size;
     unsigned int duration;
     unsigned int elapsed;
     unsigned int alive_count;
-    warrior* next_warrior;
+    unsigned int warrior_count;
+    unsigned int next_warrior;
+    warrior* warriors;
+    death_event* events;
+    unsigned int event_count;
+    battle_result* result;
     opcode* core;
+    unsigned int write_barrier;
+    unsigned int stop_at;
+    unsigned int stop_reason;
+    unsigned int watch;
+    unsigned int breakpoint;
+    uint64_t core_hash;
+    uint64_t cycle_mark;
+    unsigned int cycle_next;
+    unsigned int cycle_steps;
+    unsigned int cycle_power;
+    predecoded* decoded;
+    core_fields* fields;
     bool* blocks;
+    unsigned int* free_blocks;
+    unsigned int free_count;
+    uint8_t* dirty;
+    uint64_t seed;
+    uint64_t rng;
+    bool seeded;
+    const struct engine* engine;
 } mars;
 
+/* Idle mars of one size, ready to be handed out again by acquire_mars(). A
+ * pool is not thread-safe, so each thread playing battles should have its
+ * own. */
+typedef struct mars_pool {
+    unsigned int core_size;
+    unsigned int block_size;
+    unsigned int duration;
+    unsigned int count;
+    mars* idle[MARS_POOL_SIZE];
+} mars_pool;
+
 void destroy_mars(mars* m);
 mars create_mars(unsigned int core_size, unsigned int block_size, unsigned int duration);
-warrior load_program(mars* m, program* prog, unsigned int block, unsigned int offset);
+void reset_mars(mars* m);
+void seed_mars(mars* m, uint64_t seed);
+mars_pool create_pool(unsigned int core_size, unsigned int block_size, unsigned int duration);
+mars* acquire_mars(mars_pool* pool);
+void release_mars(mars_pool* pool, mars* m);
+void destroy_pool(mars_pool* pool);
+unsigned int load_program(mars* m, program* prog, unsigned int block, unsigned int offset);
 unsigned int get_block(mars* m);
+unsigned int get_blocks(mars* m, unsigned int count, unsigned int* blocks);
+void release_block(mars* m, unsigned int block);
+unsigned int place_programs(mars* m, program* programs, unsigned int count);
 unsigned int get_offset(mars* m, program* prog);
+const death_event* get_event(mars* m, unsigned int n);
+void predecode(mars* m, unsigned int index);
+void sync_cell(mars* m, unsigned int index, opcode old);
+void enable_cycle_detection(mars* m);
+uint64_t state_hash(mars* m);
+void enable_core_fields(mars* m);
 void tick(mars* m);
-int play(mars* m);
+int play(mars* m, battle_result* result);
+int play_fast(mars* m, battle_result* result);
+unsigned int run_cycles(mars* m, unsigned int n, const run_hooks* hooks);
 
 // DEBUG FUNCTIONS
 void print_block(mars* m, unsigned int index);
 
 #ifdef TEST_BUILD
-void insert_warrior(mars* m, warrior* w);
-void remove_warrior(mars* m, warrior* w);
+unsigned int insert_warrior(mars* m, unsigned int id, unsigned int pc);
+void remove_warrior(mars* m, unsigned int index);
 int get_operand_value(mars* m, int index, unsigned int mode, unsigned int raw_value);
 int get_operand_address(mars* m, int index, unsigned int mode, unsigned int raw_value);
 #endif
@@ -76,10 +247,12 @@ static inline int get_signed_operand_value(unsigned int raw_value) {
 }
 
 static inline int wrap_index(int index, unsigned int size) {
-    if(index < 0) {
-        return (int) size + index % (int) size;
+    int wrapped = index % (int) size;
+
+    if(wrapped < 0) {
+        return (int) size + wrapped;
     } else {
-        return index % (int) size;
+        return wrapped;
     }
 }
 
@@ -0,0 +1,45 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_PLACEMENT_H_
+#define COREWARS_1984_PLACEMENT_H_
+
+#include <stdint.h>
+
+#include "mars.h"
+
+/* Ways of choosing how far apart the two warriors of a battle start. Random
+ * placement uses get_block() and get_offset(). Spread placement splits the
+ * distances given by pair_distances() into one stratum per round and draws one
+ * from each, and exhaustive placement plays every one of them in turn. Both
+ * estimate the score averaged evenly over every distance at which the warriors
+ * do not overlap, which random placement only approximates, since it keeps
+ * the warriors to whole blocks. */
+#define PLACE_RANDOM 0
+#define PLACE_SPREAD 1
+#define PLACE_ALL 2
+
+unsigned int stratified_sample(unsigned int count, unsigned int stratum,
+                               unsigned int strata, uint64_t* rng);
+unsigned int pair_distances(unsigned int core_size, const program* first,
+                            const program* second);
+unsigned int load_pair(mars* m, program* first, program* second, unsigned int distance);
+
+#endif
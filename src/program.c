@@ -76,7 +76,8 @@ program prog_from_buffer(unsigned int id, opcode* buf, unsigned long size) {
 }
 
 /* Reads a program from the given file. The returned program will have an id of
- * UINT_MAX if an error occurred.
+ * UINT_MAX if an error occurred, or if the file does not hold a whole number
+ * of opcodes, or more than MAX_PROGRAM_SIZE of them.
  *
  * @param id - an identification number of the player that owns this program
  * @param f - a handle on the file from which to read the program
@@ -84,37 +85,52 @@ program prog_from_buffer(unsigned int id, opcode* buf, unsigned long size) {
 program prog_from_file(unsigned int id, FILE* f) {
     program prog;
 
+    prog.id = UINT_MAX;
+    prog.code = NULL;
+    prog.size = 0;
+
+    if(f == NULL) {
+        // file I/O problem
+        return prog;
+    }
+
     fseek(f, 0L, SEEK_END);
-    unsigned long length = (unsigned long) ftell(f);
+    long end = ftell(f);
     fseek(f, 0L, SEEK_SET);
 
+    if(end < 0 || (unsigned long) end > MAX_PROGRAM_SIZE * sizeof(opcode)) {
+        // unreadable, or too long to be a program
+        return prog;
+    }
+
+    unsigned long length = (unsigned long) end;
+
     if(length % sizeof(opcode) != 0) {
         // source file ends with a partial opcode
-        prog.id = UINT_MAX;
         return prog;
     }
 
     opcode* code = (opcode*) malloc(length);
 
-    int i = 0;
-    if(f) {
-        unsigned char word[sizeof(opcode)];
-
-        while(fread(word, 1, sizeof(opcode), f) == sizeof(opcode)) {
-            opcode op = 0;
+    unsigned long i = 0;
+    unsigned char word[sizeof(opcode)];
 
-            for(unsigned int j=0; j<sizeof(opcode); j++) {
-              op |= ((opcode) word[j] << (8*j));
-            }
+    while(i < length / sizeof(opcode)
+          && fread(word, 1, sizeof(opcode), f) == sizeof(opcode)) {
+        opcode op = 0;
 
-            code[i] = op;
-            i++;
+        for(unsigned int j=0; j<sizeof(opcode); j++) {
+          op |= ((opcode) word[j] << (8*j));
         }
-    } else {
-      // file I/O problem
-      prog.id = UINT_MAX;
-      prog.size = 0;
-      return prog;
+
+        code[i] = op;
+        i++;
+    }
+
+    if(i != length / sizeof(opcode)) {
+        // the file changed under us
+        free(code);
+        return prog;
     }
 
     prog.id = id;
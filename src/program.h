@@ -21,6 +21,7 @@
 #ifndef COREWARS_1984_PROGRAM_H_
 #define COREWARS_1984_PROGRAM_H_
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -0,0 +1,144 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+/* Whole-core scans for spectators and analysis tools. Each scan has an SSE2
+ * kernel, used when the compiler targets it (always, on x86-64), and a plain
+ * C version for everything else. */
+
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scan.h"
+
+/* Returns the number of cells of the given instruction type in the core. The
+ * field arrays are scanned 16 cells at a time if the mars has them; otherwise
+ * every opcode is unpacked.
+ *
+ * @param m - the mars whose core to scan
+ * @param type - an instruction type, e.g. DAT_TYPE
+ * @return how many cells of the core hold an instruction of that type */
+unsigned int count_type(mars* m, unsigned int type) {
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+    if(m->fields == NULL) {
+        for(; i<m->core_size; i++) {
+            if(((m->core[i] & OP_TYPE_MASK) >> TYPE_OFFSET) == type) {
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+    const uint8_t* types = m->fields->type;
+
+#ifdef __SSE2__
+    const __m128i needle = _mm_set1_epi8((char) type);
+
+    for(; i + 16 <= m->core_size; i += 16) {
+        __m128i block = _mm_load_si128((const __m128i*) (types + i));
+        int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        count += (unsigned int) __builtin_popcount((unsigned int) matches);
+    }
+#endif
+
+    for(; i<m->core_size; i++) {
+        if(types[i] == type) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* Counts the cells of every instruction type in the core.
+ *
+ * @param m - the mars whose core to scan
+ * @param counts - filled with the number of cells of each type */
+void count_types(mars* m, unsigned int counts[1 << INSTRUCTION_TYPE_WIDTH]) {
+    for(unsigned int type=0; type < (1 << INSTRUCTION_TYPE_WIDTH); type++) {
+        counts[type] = count_type(m, type);
+    }
+}
+
+/* Returns the address of the first cell at or after start which is not all
+ * zeroes (i.e. not DAT #0), without wrapping around the end of the core.
+ *
+ * @param m - the mars whose core to scan
+ * @param start - the address at which to start scanning
+ * @return the address of a non-zero cell, or UINT_MAX if there is none */
+unsigned int find_nonzero(mars* m, unsigned int start) {
+    unsigned int i = start;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; i + 4 <= m->core_size; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (m->core + i));
+        int zeroes = _mm_movemask_epi8(_mm_cmpeq_epi32(block, zero));
+
+        if(zeroes != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+
+    for(; i<m->core_size; i++) {
+        if(m->core[i] != 0) {
+            return i;
+        }
+    }
+
+    return UINT_MAX;
+}
+
+/* Compares two regions of core memory, for instance the same block of two
+ * mars or a block against a program's code.
+ *
+ * @param a - the first region
+ * @param b - the second region
+ * @param size - the number of cells in each region
+ * @return the offset of the first cell that differs, or size if none do */
+unsigned int compare_regions(const opcode* a, const opcode* b, unsigned int size) {
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    for(; i + 4 <= size; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(x, y)) != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+
+    for(; i<size; i++) {
+        if(a[i] != b[i]) {
+            return i;
+        }
+    }
+
+    return size;
+}
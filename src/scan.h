@@ -0,0 +1,31 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_SCAN_H_
+#define COREWARS_1984_SCAN_H_
+
+#include "mars.h"
+
+unsigned int count_type(mars* m, unsigned int type);
+void count_types(mars* m, unsigned int counts[1 << INSTRUCTION_TYPE_WIDTH]);
+unsigned int find_nonzero(mars* m, unsigned int start);
+unsigned int compare_regions(const opcode* a, const opcode* b, unsigned int size);
+
+#endif
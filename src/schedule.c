@@ -0,0 +1,250 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+#include "topology.h"
+
+/* How long a worker which found nothing to steal first sleeps, in
+ * nanoseconds, and the most it sleeps once repeated failures have doubled
+ * that. */
+#define BACKOFF_MIN_NS 1000
+#define BACKOFF_MAX_NS 1000000
+
+/* The tasks a worker has yet to run, which are always a range of task
+ * numbers. The owner takes tasks from the top of the range, and thieves take
+ * the bottom half of it. */
+typedef struct deque {
+    pthread_mutex_t lock;
+    unsigned int begin;
+    unsigned int end;
+} deque;
+
+struct batch;
+
+/* A worker thread of a batch. */
+typedef struct worker {
+    struct batch* batch;
+    unsigned int index;
+    unsigned int random;
+    deque tasks;
+    worker_stats stats;
+    pthread_t thread;
+} worker;
+
+/* A batch of tasks being run, and the number of them not yet finished. */
+typedef struct batch {
+    task_fn run;
+    void* context;
+    worker* workers;
+    unsigned int threads;
+    unsigned int remaining;
+    unsigned int cpu_count;
+    unsigned int cpus[MAX_CPUS];
+} batch;
+
+/* @return the time in seconds from an arbitrary starting point */
+static double now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+/* @return the next number from a worker's xorshift generator */
+static unsigned int next_random(worker* w) {
+    w->random ^= w->random << 13;
+    w->random ^= w->random >> 17;
+    w->random ^= w->random << 5;
+
+    return w->random;
+}
+
+/* Takes the task at the top of a worker's own deque.
+ *
+ * @return whether there was one */
+static bool pop(worker* w, unsigned int* task) {
+    bool found = false;
+
+    pthread_mutex_lock(&w->tasks.lock);
+
+    if(w->tasks.begin < w->tasks.end) {
+        *task = --w->tasks.end;
+        found = true;
+    }
+
+    pthread_mutex_unlock(&w->tasks.lock);
+
+    return found;
+}
+
+/* Moves the bottom half of a random victim's deque, rounded up, into the
+ * given worker's deque, which is empty.
+ *
+ * @return whether anything was stolen */
+static bool steal(worker* w) {
+    batch* b = w->batch;
+    unsigned int victim = next_random(w) % b->threads;
+
+    for(unsigned int i=0; i<b->threads; i++, victim = (victim + 1) % b->threads) {
+        deque* tasks = &b->workers[victim].tasks;
+
+        if(victim == w->index) {
+            continue;
+        }
+
+        pthread_mutex_lock(&tasks->lock);
+
+        unsigned int begin = tasks->begin;
+        unsigned int count = (tasks->end - begin + 1) / 2;
+        tasks->begin += count;
+
+        pthread_mutex_unlock(&tasks->lock);
+
+        if(count != 0) {
+            pthread_mutex_lock(&w->tasks.lock);
+            w->tasks.begin = begin;
+            w->tasks.end = begin + count;
+            pthread_mutex_unlock(&w->tasks.lock);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* The loop of a worker thread, which pins itself to its CPU if the batch is
+ * pinned, runs tasks from its own deque, steals more when it runs out, and
+ * stops once every task of the batch is done. A worker which finds nothing to
+ * steal sleeps for longer and longer before trying again, so that idle workers
+ * near the end of a batch leave their CPUs, and any SMT siblings, to the
+ * workers still running tasks. */
+static void* work(void* arg) {
+    worker* w = (worker*) arg;
+    batch* b = w->batch;
+    unsigned int task;
+    long backoff = BACKOFF_MIN_NS;
+    bool stolen = false;
+
+    if(b->cpu_count != 0) {
+        unsigned int cpu = b->cpus[w->index % b->cpu_count];
+
+        if(pin_to_cpu(cpu)) {
+            w->stats.cpu = (int) cpu;
+        }
+    }
+
+    double start = now();
+
+    while(__atomic_load_n(&b->remaining, __ATOMIC_ACQUIRE) != 0) {
+        if(pop(w, &task)) {
+            double begin = now();
+
+            b->run(b->context, task, w->index);
+            w->stats.busy += now() - begin;
+            w->stats.tasks++;
+
+            if(stolen) {
+                w->stats.stolen++;
+            }
+
+            __atomic_sub_fetch(&b->remaining, 1, __ATOMIC_RELEASE);
+        } else if(steal(w)) {
+            // a worker only steals once its own tasks have run out, so every
+            // task it runs from now on came from another worker, though a
+            // range may be stolen on from it before its tasks are run here
+            stolen = true;
+            backoff = BACKOFF_MIN_NS;
+        } else {
+            struct timespec pause = { 0, backoff };
+
+            nanosleep(&pause, NULL);
+            backoff = backoff * 2 < BACKOFF_MAX_NS ? backoff * 2 : BACKOFF_MAX_NS;
+        }
+    }
+
+    w->stats.idle = now() - start - w->stats.busy;
+
+    return NULL;
+}
+
+/* Runs a batch of tasks of uneven lengths, such as battles, on a pool of
+ * threads. The tasks start out shared evenly between the workers, each in a
+ * deque of its own, and a worker that runs out steals half of the remaining
+ * tasks of another, picked at random, so workers only sit idle once there is
+ * nothing left to steal. Tasks may run in any order, and concurrently with
+ * each other.
+ *
+ * Workers may be pinned to the CPUs the process may run on, one each, in turn.
+ * Memory a task allocates and first touches then stays on the NUMA node of its
+ * worker's CPU, so a task should create what it works on, such as its mars,
+ * itself rather than share it with other workers.
+ *
+ * @param task_count - the number of tasks, which are numbered from 0
+ * @param threads - the number of worker threads to run them on
+ * @param run - runs a task
+ * @param context - passed to each call of run
+ * @param pin - whether to pin each worker to a CPU
+ * @param stats - filled with what each worker did; may be NULL */
+void run_batch(unsigned int task_count, unsigned int threads, task_fn run,
+               void* context, bool pin, worker_stats* stats) {
+    batch* b = (batch*) malloc(sizeof(batch));
+
+    *b = (batch) { run, context, NULL, threads, task_count, 0, { 0 } };
+    b->workers = (worker*) malloc(threads * sizeof(worker));
+
+    if(pin) {
+        b->cpu_count = usable_cpus(b->cpus, MAX_CPUS);
+    }
+
+    for(unsigned int i=0; i<threads; i++) {
+        worker* w = &b->workers[i];
+
+        w->batch = b;
+        w->index = i;
+        w->random = 2654435761u * (i + 1);
+        pthread_mutex_init(&w->tasks.lock, NULL);
+        w->tasks.begin = (unsigned int) ((unsigned long long) task_count * i / threads);
+        w->tasks.end = (unsigned int) ((unsigned long long) task_count * (i + 1) / threads);
+        w->stats = (worker_stats) { -1, 0, 0, 0.0, 0.0 };
+    }
+
+    for(unsigned int i=0; i<threads; i++) {
+        pthread_create(&b->workers[i].thread, NULL, work, &b->workers[i]);
+    }
+
+    for(unsigned int i=0; i<threads; i++) {
+        pthread_join(b->workers[i].thread, NULL);
+        pthread_mutex_destroy(&b->workers[i].tasks.lock);
+
+        if(stats != NULL) {
+            stats[i] = b->workers[i].stats;
+        }
+    }
+
+    free(b->workers);
+    free(b);
+}
@@ -0,0 +1,45 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#ifndef COREWARS_1984_SCHEDULE_H_
+#define COREWARS_1984_SCHEDULE_H_
+
+#include <stdbool.h>
+
+/* Runs task number task of a batch, given the context of the batch, on the
+ * worker with the given index. */
+typedef void (*task_fn)(void* context, unsigned int task, unsigned int worker);
+
+/* What one worker thread of a batch did: how many tasks it ran and how many
+ * of those it ran after stealing them from other workers, how long it spent running tasks and
+ * otherwise, looking for work or waiting for the batch to finish, and the CPU
+ * it was pinned to, or -1 if it was not. */
+typedef struct worker_stats {
+    int cpu;
+    unsigned int tasks;
+    unsigned int stolen;
+    double busy;
+    double idle;
+} worker_stats;
+
+void run_batch(unsigned int task_count, unsigned int threads, task_fn run,
+               void* context, bool pin, worker_stats* stats);
+
+#endif
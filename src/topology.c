@@ -0,0 +1,148 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+/* The CPU topology of the machine, as Linux reports it in sysfs, and pinning
+ * of threads to CPUs. Memory is allocated on the NUMA node of the CPU which
+ * first touches it, so a thread pinned before it creates its mars gets a core
+ * local to its CPU. Elsewhere, every CPU is reported as usable, on no known
+ * node or package, and pinning does nothing. */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "topology.h"
+
+/* Lists the CPUs the calling process may run on, in increasing order.
+ *
+ * @param cpus - filled with the numbers of the usable CPUs
+ * @param max - the most CPUs to list
+ * @return the number of CPUs listed */
+unsigned int usable_cpus(unsigned int* cpus, unsigned int max) {
+    unsigned int count = 0;
+
+#ifdef __linux__
+    cpu_set_t set;
+
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(unsigned int cpu=0; cpu<CPU_SETSIZE && count<max; cpu++) {
+            if(CPU_ISSET(cpu, &set)) {
+                cpus[count++] = cpu;
+            }
+        }
+
+        return count;
+    }
+#endif
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for(long cpu=0; cpu<online && count<max; cpu++) {
+        cpus[count++] = (unsigned int) cpu;
+    }
+
+    return count;
+}
+
+/* @return the NUMA node of the given CPU, or -1 if it is not known. The node
+ *         is read from the nodeN link in the CPU's sysfs directory, since node
+ *         numbers need not be contiguous. */
+int cpu_node(unsigned int cpu) {
+    char path[64];
+    struct dirent* entry;
+    int node = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+    DIR* dir = opendir(path);
+
+    if(dir == NULL) {
+        return -1;
+    }
+
+    while(node < 0 && (entry = readdir(dir)) != NULL) {
+        if(sscanf(entry->d_name, "node%d", &node) != 1) {
+            node = -1;
+        }
+    }
+
+    closedir(dir);
+
+    return node;
+}
+
+/* @return the physical package (socket) of the given CPU, or -1 if it is not
+ *         known */
+int cpu_package(unsigned int cpu) {
+    char path[80];
+    int package = -1;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+    FILE* f = fopen(path, "r");
+
+    if(f != NULL) {
+        if(fscanf(f, "%d", &package) != 1) {
+            package = -1;
+        }
+
+        fclose(f);
+    }
+
+    return package;
+}
+
+/* Pins the calling thread to the given CPU.
+ *
+ * @return whether the thread was pinned */
+bool pin_to_cpu(unsigned int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+
+    if(cpu >= CPU_SETSIZE) {
+        return false;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void) cpu;
+    return false;
+#endif
+}
+
+/* Prints the usable CPUs with the package and NUMA node of each. */
+void print_topology(FILE* out) {
+    unsigned int cpus[MAX_CPUS];
+    unsigned int count = usable_cpus(cpus, MAX_CPUS);
+
+    fprintf(out, "%u usable CPUs\n", count);
+
+    for(unsigned int i=0; i<count; i++) {
+        fprintf(out, "cpu %u: package %d, node %d\n", cpus[i],
+                cpu_package(cpus[i]), cpu_node(cpus[i]));
+    }
+}
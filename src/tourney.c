@@ -0,0 +1,399 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "farm.h"
+#include "mars.h"
+#include "placement.h"
+#include "schedule.h"
+#include "topology.h"
+#include "utils.h"
+
+/* Settings of every battle in a tournament. Blocks are as large as the
+ * largest program, so that any program fits in one, and the core, whose size
+ * defaults to TOURNEY_CORE_SIZE, must hold at least two. */
+#define TOURNEY_CORE_SIZE 8000
+#define TOURNEY_BLOCK_SIZE MAX_PROGRAM_SIZE
+#define TOURNEY_DURATION 80000
+
+/* The outcome of a battle which exhaustive placement has no distance for,
+ * since its pairing has fewer distances than the longest one. */
+#define SKIPPED (-4)
+
+/* Points scored for each battle won and drawn. */
+#define WIN_POINTS 3
+#define DRAW_POINTS 1
+
+/* A round-robin tournament: every pairing of the warriors fights the given
+ * number of rounds. Battles are numbered pairing by pairing, and run as a
+ * batch by run_batch(); each stores its winner in outcomes. Each worker of the
+ * batch plays from its own copies of the warriors, which it makes itself so
+ * that they are local to its CPU, on mars from its own pool, and counts the
+ * ticks it simulates. Every battle is placed from a seed derived from the
+ * tournament's seed by battle_seed(), so the results do not depend on how the
+ * battles were shared out. Cycle detection, which only ends looping battles
+ * sooner with the same outcome but slows every write, is off unless asked
+ * for. */
+typedef struct tourney {
+    uint64_t seed;
+    int placement;
+    bool detect_cycles;
+    unsigned int core_size;
+    program* warriors;
+    unsigned int warrior_count;
+    unsigned int rounds;
+    unsigned int battle_count;
+    int* outcomes;
+    program** copies;
+    mars_pool* pools;
+    unsigned long long* ticks;
+} tourney;
+
+/* Finds the pairing and round of a battle of the given tournament. */
+static void battle_of(const tourney* t, unsigned int battle, unsigned int* a,
+                      unsigned int* b, unsigned int* round) {
+    unsigned int pairing = battle / t->rounds;
+
+    *round = battle % t->rounds;
+    *a = 0;
+
+    while(pairing >= t->warrior_count - 1 - *a) {
+        pairing -= t->warrior_count - 1 - *a;
+        (*a)++;
+    }
+
+    *b = *a + 1 + pairing;
+}
+
+/* Plays one battle of a tournament on the given empty mars, from the battle's
+ * own seed. The warriors take turns going first from round to round. With
+ * random placement, both are placed the way get_block() and get_offset() do.
+ * With spread placement, each round of a pairing draws the distance between
+ * the warriors from its own stratum of the distances at which they do not
+ * overlap, and with exhaustive placement each pair of rounds plays the next
+ * of those distances both ways round.
+ *
+ * @param warriors - the copies of the tournament's warriors to play from
+ * @param m - an empty mars of the tournament's settings
+ * @return the index of the winning warrior, -1 for a draw, or SKIPPED */
+static int fight(const tourney* t, program* warriors, mars* m, unsigned int battle) {
+    unsigned int a, b, round;
+
+    battle_of(t, battle, &a, &b, &round);
+    seed_mars(m, battle_seed(t->seed, a, b, round));
+
+    program* first = &warriors[round % 2 == 0 ? a : b];
+    program* second = &warriors[round % 2 == 0 ? b : a];
+
+    if(t->placement == PLACE_RANDOM) {
+        // the order of the draws is part of the placement a seed gives, so
+        // they are not left to the order arguments are evaluated in
+        unsigned int block = get_block(m);
+        unsigned int offset = get_offset(m, first);
+        load_program(m, first, block, offset);
+
+        block = get_block(m);
+        offset = get_offset(m, second);
+        load_program(m, second, block, offset);
+    } else {
+        unsigned int count = pair_distances(t->core_size, &warriors[a], &warriors[b]);
+        unsigned int index = round / 2;
+
+        if(t->placement == PLACE_SPREAD) {
+            index = stratified_sample(count, round, t->rounds, &m->rng);
+        } else if(index >= count) {
+            return SKIPPED;
+        }
+
+        // distance is how far b starts after a, whichever goes first
+        unsigned int distance = (unsigned int) warriors[a].size + index;
+        load_pair(m, first, second, round % 2 == 0 ? distance : t->core_size - distance);
+    }
+
+    if(t->detect_cycles) {
+        enable_cycle_detection(m);
+    }
+
+    return play_fast(m, NULL);
+}
+
+/* Plays a battle of a tournament in a worker process of run_farm(), on a
+ * fresh mars so that nothing is left behind by a battle that crashed. */
+static int farm_battle(void* context, unsigned int battle) {
+    tourney* t = (tourney*) context;
+    mars m = create_mars(t->core_size, TOURNEY_BLOCK_SIZE, TOURNEY_DURATION);
+
+    int winner = fight(t, t->warriors, &m, battle);
+    destroy_mars(&m);
+
+    return winner;
+}
+
+/* Plays a battle of a tournament, as a task of run_batch(). A worker copies
+ * the warriors before its first battle. */
+static void run_battle(void* context, unsigned int battle, unsigned int worker) {
+    tourney* t = (tourney*) context;
+
+    if(t->copies[worker] == NULL) {
+        program* copies = (program*) malloc(t->warrior_count * sizeof(program));
+
+        for(unsigned int i=0; i<t->warrior_count; i++) {
+            copies[i] = prog_from_buffer(i, t->warriors[i].code, t->warriors[i].size);
+        }
+
+        t->copies[worker] = copies;
+    }
+
+    mars* m = acquire_mars(&t->pools[worker]);
+
+    t->outcomes[battle] = fight(t, t->copies[worker], m, battle);
+    t->ticks[worker] += m->elapsed;
+    release_mars(&t->pools[worker], m);
+}
+
+/* Prints the points each warrior scored against each other warrior, and their
+ * totals. */
+static void print_scores(const tourney* t, char* names[]) {
+    unsigned int n = t->warrior_count;
+    unsigned int* scores = (unsigned int*) calloc(n * n, sizeof(unsigned int));
+
+    for(unsigned int battle=0; battle<t->battle_count; battle++) {
+        unsigned int a, b, round;
+        int winner = t->outcomes[battle];
+
+        battle_of(t, battle, &a, &b, &round);
+
+        if(winner == FARM_CRASHED || winner == FARM_UNPLAYED || winner == SKIPPED) {
+            continue;
+        } else if(winner < 0) {
+            scores[a * n + b] += DRAW_POINTS;
+            scores[b * n + a] += DRAW_POINTS;
+        } else if((unsigned int) winner == a) {
+            scores[a * n + b] += WIN_POINTS;
+        } else {
+            scores[b * n + a] += WIN_POINTS;
+        }
+    }
+
+    printf("%4s", "");
+    for(unsigned int j=0; j<n; j++) {
+        printf(" %6u", j);
+    }
+    printf(" %8s\n", "total");
+
+    for(unsigned int i=0; i<n; i++) {
+        unsigned int total = 0;
+
+        printf("%4u", i);
+        for(unsigned int j=0; j<n; j++) {
+            if(i == j) {
+                printf(" %6s", "-");
+            } else {
+                printf(" %6u", scores[i * n + j]);
+                total += scores[i * n + j];
+            }
+        }
+        printf(" %8u  %s\n", total, names[i]);
+    }
+
+    free(scores);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int threads = (unsigned int) sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int processes = 0;
+    bool pin = false;
+    uint64_t seed = random_seed();
+    int placement = PLACE_RANDOM;
+    unsigned int core_size = TOURNEY_CORE_SIZE;
+    bool detect_cycles = false;
+    int option;
+
+    while((option = getopt(argc, argv, "t:p:as:d:c:r")) != -1) {
+        if(option == 't') {
+            threads = (unsigned int) atoi(optarg);
+        } else if(option == 'a') {
+            pin = true;
+        } else if(option == 's') {
+            seed = strtoull(optarg, NULL, 0);
+        } else if(option == 'd') {
+            if(strcmp(optarg, "random") == 0) {
+                placement = PLACE_RANDOM;
+            } else if(strcmp(optarg, "spread") == 0) {
+                placement = PLACE_SPREAD;
+            } else if(strcmp(optarg, "all") == 0) {
+                placement = PLACE_ALL;
+            } else {
+                return 1;
+            }
+        } else if(option == 'r') {
+            detect_cycles = true;
+        } else if(option == 'c') {
+            core_size = (unsigned int) strtoul(optarg, NULL, 10);
+        } else if(option == 'p') {
+            processes = (unsigned int) atoi(optarg);
+        } else {
+            return 1;
+        }
+    }
+
+    if(argc - optind < 3 || atoi(argv[optind]) <= 0 || threads == 0
+       || core_size < 2 * TOURNEY_BLOCK_SIZE) {
+        printf("Usage:\n    ./build/tourney [-t threads [-a] | -p processes] [-s seed] [-c core_size] [-d random|spread|all] [-r] rounds warrior.hex warrior.hex...\n");
+        printf("The core must hold at least %u cells.\n", 2 * TOURNEY_BLOCK_SIZE);
+        return 1;
+    }
+
+    tourney t;
+    t.seed = seed;
+    t.placement = placement;
+    t.detect_cycles = detect_cycles;
+    t.core_size = core_size;
+    t.rounds = (unsigned int) atoi(argv[optind]);
+
+    t.warrior_count = (unsigned int) (argc - optind - 1);
+    t.warriors = (program*) malloc(t.warrior_count * sizeof(program));
+    char** names = &argv[optind + 1];
+
+    for(unsigned int i=0; i<t.warrior_count; i++) {
+        char* name = names[i];
+        FILE* f = fopen(name, "r");
+
+        if(f == NULL) {
+            printf("Could not open %s\n", name);
+            return 1;
+        }
+
+        t.warriors[i] = prog_from_file(i, f);
+        fclose(f);
+
+        if(t.warriors[i].id == UINT_MAX || t.warriors[i].size > TOURNEY_BLOCK_SIZE) {
+            printf("%s is not a valid program\n", name);
+            return 1;
+        }
+    }
+
+    // exhaustive placement plays every distance of each pairing both ways
+    // round, whatever number of rounds was asked for; pairings with fewer
+    // distances than the most skip their last rounds
+    if(placement == PLACE_ALL) {
+        t.rounds = 0;
+
+        for(unsigned int a=0; a<t.warrior_count; a++) {
+            for(unsigned int b=a+1; b<t.warrior_count; b++) {
+                unsigned int count = pair_distances(core_size, &t.warriors[a], &t.warriors[b]);
+
+                if(2 * count > t.rounds) {
+                    t.rounds = 2 * count;
+                }
+            }
+        }
+    }
+
+    uint64_t battles = (uint64_t) t.warrior_count * (t.warrior_count - 1) / 2 * t.rounds;
+
+    if(battles > UINT_MAX || battles * sizeof(int) > SIZE_MAX) {
+        printf("Too many battles: %llu\n", (unsigned long long) battles);
+        return 1;
+    }
+
+    t.battle_count = (unsigned int) battles;
+    t.outcomes = (int*) malloc(t.battle_count * sizeof(int));
+
+    // the seed goes to stderr with the other reports, so that a tournament can
+    // be played again exactly with -s
+    fprintf(stderr, "seed %llu\n", (unsigned long long) seed);
+
+    if(processes != 0) {
+        unsigned int deaths = run_farm(t.battle_count, processes, farm_battle, &t, t.outcomes);
+
+        print_scores(&t, names);
+
+        unsigned int unplayed = 0;
+
+        for(unsigned int i=0; i<t.battle_count; i++) {
+            unplayed += t.outcomes[i] == FARM_UNPLAYED ? 1 : 0;
+        }
+
+        if(deaths != 0) {
+            fprintf(stderr, "%u worker processes died\n", deaths);
+        }
+
+        if(unplayed != 0) {
+            fprintf(stderr, "%u battles were not played, for want of workers\n", unplayed);
+        }
+    } else {
+        worker_stats* stats = (worker_stats*) malloc(threads * sizeof(worker_stats));
+        t.copies = (program**) calloc(threads, sizeof(program*));
+        t.ticks = (unsigned long long*) calloc(threads, sizeof(unsigned long long));
+        t.pools = (mars_pool*) malloc(threads * sizeof(mars_pool));
+
+        for(unsigned int i=0; i<threads; i++) {
+            t.pools[i] = create_pool(t.core_size, TOURNEY_BLOCK_SIZE, TOURNEY_DURATION);
+        }
+
+        // the topology and how evenly the battles were spread go to stderr,
+        // so that the scores can be piped on their own
+        if(pin) {
+            print_topology(stderr);
+        }
+
+        run_batch(t.battle_count, threads, run_battle, &t, pin, stats);
+
+        print_scores(&t, names);
+
+        for(unsigned int i=0; i<threads; i++) {
+            double rate = stats[i].busy > 0.0 ? (double) t.ticks[i] / stats[i].busy : 0.0;
+
+            fprintf(stderr, "worker %u (cpu %d): %u battles (%u stolen), busy %.3fs, idle %.3fs, %.0f cycles/s\n",
+                    i, stats[i].cpu, stats[i].tasks, stats[i].stolen, stats[i].busy,
+                    stats[i].idle, rate);
+
+            if(t.copies[i] != NULL) {
+                for(unsigned int j=0; j<t.warrior_count; j++) {
+                    destroy_program(&t.copies[i][j]);
+                }
+
+                free(t.copies[i]);
+            }
+
+            destroy_pool(&t.pools[i]);
+        }
+
+        free(t.pools);
+        free(t.ticks);
+        free(t.copies);
+        free(stats);
+    }
+
+    for(unsigned int i=0; i<t.warrior_count; i++) {
+        destroy_program(&t.warriors[i]);
+    }
+
+    free(t.outcomes);
+    free(t.warriors);
+
+    return 0;
+}
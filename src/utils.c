@@ -19,16 +19,120 @@
  */
 
 #include <stdio.h>
+#include <time.h>
 
 #include "utils.h"
+#include "hash.h"
 
-/* @return a random unsigned integer from /dev/urandom. */
-unsigned int randuint(void) {
-    unsigned int val;
-
+/* @return a seed for rng_next() read from /dev/urandom, or made from the time
+ *         if that cannot be read */
+uint64_t random_seed(void) {
+    uint64_t seed;
     FILE* f = fopen("/dev/urandom", "r");
-    fread(&val, sizeof(val), 1, f);
-    fclose(f);
 
-    return val;
+    if(f == NULL || fread(&seed, sizeof(seed), 1, f) != 1) {
+        struct timespec now;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        seed = (uint64_t) now.tv_sec * 1000000007u + (uint64_t) now.tv_nsec;
+    }
+
+    if(f != NULL) {
+        fclose(f);
+    }
+
+    return seed;
+}
+
+/* Advances a splitmix64 generator, whose whole state is one 64-bit word, so
+ * any value is a valid seed, and the same seed always gives the same numbers.
+ * The state is only a counter stepped by a constant, and each number is a
+ * hash of it, so streams from different seeds share nothing.
+ *
+ * @param state - the state of the generator, which is updated
+ * @return the next 64-bit random number */
+uint64_t rng_next(uint64_t* state) {
+    return mix64(*state += 0x9E3779B97F4A7C15u);
+}
+
+/* Draws a number uniformly from 0 up to but not including bound, without the
+ * bias of taking a remainder, by scaling a 32-bit random number up to a 64-bit
+ * product and rejecting the few which would favour some results.
+ *
+ * @param state - the state of the generator, which is updated
+ * @param bound - the number of possible results, which must not be 0
+ * @return a random number less than bound */
+unsigned int rng_below(uint64_t* state, unsigned int bound) {
+    uint64_t product = (rng_next(state) >> 32) * bound;
+
+    if((uint32_t) product < bound) {
+        uint32_t threshold = (uint32_t) -bound % bound;
+
+        while((uint32_t) product < threshold) {
+            product = (rng_next(state) >> 32) * bound;
+        }
+    }
+
+    return (unsigned int) (product >> 32);
+}
+
+/* Multipliers and key increments of Philox4x32, from Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3" (SC 2011). */
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/* Philox4x32-10, a counter-based generator: a keyed bijection of 128-bit
+ * counters, so the numbers for any counter can be had directly, in any order,
+ * without a state to share.
+ *
+ * @param counter - the counter to encrypt
+ * @param key - the key, which picks one of 2^64 independent streams
+ * @param out - set to the four random words for the counter */
+void philox(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for(unsigned int i=0; i<4; i++) {
+        out[i] = counter[i];
+    }
+
+    for(unsigned int round=0; round<PHILOX_ROUNDS; round++) {
+        if(round != 0) {
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        uint64_t p0 = (uint64_t) PHILOX_M0 * out[0];
+        uint64_t p1 = (uint64_t) PHILOX_M1 * out[2];
+
+        uint32_t x0 = (uint32_t) (p1 >> 32) ^ out[1] ^ k0;
+        uint32_t x2 = (uint32_t) (p0 >> 32) ^ out[3] ^ k1;
+
+        out[1] = (uint32_t) p1;
+        out[3] = (uint32_t) p0;
+        out[0] = x0;
+        out[2] = x2;
+    }
+}
+
+/* Derives the seed of one battle of a tournament from the tournament's seed,
+ * the two warriors and the round, as a Philox counter. A battle's placements
+ * so never depend on which battles were played before it or where, and any
+ * one of them can be played again on its own.
+ *
+ * @param seed - the seed of the tournament
+ * @param a - the index of the first warrior of the pairing
+ * @param b - the index of the second warrior of the pairing
+ * @param round - the round of the pairing
+ * @return the seed to give the battle's mars */
+uint64_t battle_seed(uint64_t seed, unsigned int a, unsigned int b, unsigned int round) {
+    const uint32_t counter[4] = { a, b, round, 0 };
+    const uint32_t key[2] = { (uint32_t) seed, (uint32_t) (seed >> 32) };
+    uint32_t out[4];
+
+    philox(counter, key, out);
+
+    return (uint64_t) out[1] << 32 | out[0];
 }
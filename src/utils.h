@@ -21,6 +21,12 @@
 #ifndef COREWARS_1984_UTILS_H_
 #define COREWARS_1984_UTILS_H_
 
-unsigned int randuint(void);
+#include <stdint.h>
+
+uint64_t random_seed(void);
+uint64_t rng_next(uint64_t* state);
+unsigned int rng_below(uint64_t* state, unsigned int bound);
+void philox(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+uint64_t battle_seed(uint64_t seed, unsigned int a, unsigned int b, unsigned int round);
 
 #endif
@@ -0,0 +1,145 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../lib/unity/unity.h"
+#include "../src/farm.h"
+
+#define BATTLES 40
+
+/* How many more calls of fork() may succeed before it starts failing, or -1
+ * for no limit. */
+int forks_left = -1;
+
+/* Stands in for the fork() of the C library, failing once forks_left runs
+ * out, so that the test can make run_farm() run out of workers. */
+pid_t fork(void) {
+    pid_t (*real_fork)(void);
+
+    // the cast POSIX recommends, since C has no conversion from void* to a
+    // function pointer
+    *(void**) &real_fork = dlsym(RTLD_NEXT, "fork");
+
+    if(forks_left == 0) {
+        errno = EAGAIN;
+        return -1;
+    } else if(forks_left > 0) {
+        forks_left--;
+    }
+
+    return real_fork();
+}
+
+/* Plays a fake battle, whose result is thrice its number. Battle 5 kills its
+ * worker every time, and battle 7 only the first time, which is counted in
+ * memory shared with the test. */
+int fake_battle(void* context, unsigned int battle) {
+    unsigned int* tries = (unsigned int*) context;
+
+    if(battle == 5 || (battle == 7 && __atomic_fetch_add(tries, 1, __ATOMIC_SEQ_CST) == 0)) {
+        raise(SIGKILL);
+    }
+
+    return (int) battle * 3;
+}
+
+void check_farm(unsigned int workers) {
+    unsigned int* tries = (unsigned int*) mmap(NULL, sizeof(unsigned int),
+                                               PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int results[BATTLES];
+
+    *tries = 0;
+
+    TEST_ASSERT_EQUAL(3, run_farm(BATTLES, workers, fake_battle, tries, results));
+
+    for(unsigned int i=0; i<BATTLES; i++) {
+        if(i == 5) {
+            TEST_ASSERT_EQUAL(FARM_CRASHED, results[i]);
+        } else {
+            TEST_ASSERT_EQUAL(i * 3, results[i]);
+        }
+    }
+
+    munmap(tries, sizeof(unsigned int));
+}
+
+void test_farm(void) {
+    check_farm(1);
+    check_farm(4);
+}
+
+void test_farm_empty(void) {
+    int results[1] = { 42 };
+
+    TEST_ASSERT_EQUAL(0, run_farm(0, 2, fake_battle, NULL, results));
+    TEST_ASSERT_EQUAL(42, results[0]);
+}
+
+void test_farm_no_workers(void) {
+    unsigned int* tries = (unsigned int*) mmap(NULL, sizeof(unsigned int),
+                                               PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int results[BATTLES];
+
+    *tries = 0;
+
+    // no worker can be started at all, so nothing is played
+    forks_left = 0;
+    TEST_ASSERT_EQUAL(0, run_farm(BATTLES, 2, fake_battle, tries, results));
+
+    for(unsigned int i=0; i<BATTLES; i++) {
+        TEST_ASSERT_EQUAL(FARM_UNPLAYED, results[i]);
+    }
+
+    // the only worker dies on battle 5 and cannot be replaced, so the battles
+    // after it are left unplayed rather than played here, where battle 5
+    // would kill the test
+    forks_left = 1;
+    TEST_ASSERT_EQUAL(1, run_farm(BATTLES, 1, fake_battle, tries, results));
+    forks_left = -1;
+
+    for(unsigned int i=0; i<BATTLES; i++) {
+        if(i < 5) {
+            TEST_ASSERT_EQUAL(i * 3, results[i]);
+        } else {
+            TEST_ASSERT_EQUAL(FARM_UNPLAYED, results[i]);
+        }
+    }
+
+    munmap(tries, sizeof(unsigned int));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_farm);
+    RUN_TEST(test_farm_empty);
+    RUN_TEST(test_farm_no_workers);
+    UNITY_END();
+
+    return 0;
+}
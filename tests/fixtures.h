@@ -0,0 +1,68 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+/* Programs and helpers shared by the tests of the simulator. Each test binary
+ * is built from a single test file, so this defines them outright. */
+
+#ifndef COREWARS_1984_TESTS_FIXTURES_H_
+#define COREWARS_1984_TESTS_FIXTURES_H_
+
+#include "../lib/unity/unity.h"
+#include "../src/mars.h"
+
+#define TEST_ASSERT_EQUAL_OPCODE_ARRAY TEST_ASSERT_EQUAL_UINT32_ARRAY
+
+// assembled copies of the programs in programs/
+opcode IMP[] = { 0x15000001 };
+opcode DWARF[] = { 0x21004003, 0x12001002, 0x41000FFE, 0x00000002 };
+opcode GEMINI[] = {
+    0x1100003B, 0x1103203C, 0x1A006007, 0x21001005, 0x21001005,
+    0x74003008, 0x4100002E, 0x41000FFB, 0x00000000, 0x00000032
+};
+
+/* Copies code into the core at base and adds a warrior starting there, whose
+ * record is returned through w. */
+void place(mars* m, warrior** w, opcode* code, unsigned int size,
+           unsigned int base) {
+    for(unsigned int i=0; i<size; i++) {
+        m->core[(base + i) % m->core_size] = code[i];
+    }
+
+    *w = &m->warriors[insert_warrior(m, 0, base)];
+}
+
+/* Checks that two mars which were loaded the same way and then run in
+ * different ways, such as on different engines, ended up in the same state:
+ * at the same tick, with the same warriors alive at the same addresses, and
+ * with the same core. */
+void assert_same_state(const mars* expected, const mars* actual) {
+    TEST_ASSERT_EQUAL(expected->elapsed, actual->elapsed);
+    TEST_ASSERT_EQUAL(expected->alive_count, actual->alive_count);
+    TEST_ASSERT_EQUAL(expected->warrior_count, actual->warrior_count);
+
+    for(unsigned int i=0; i<expected->warrior_count; i++) {
+        TEST_ASSERT_EQUAL(expected->warriors[i].PC, actual->warriors[i].PC);
+    }
+
+    TEST_ASSERT_EQUAL(expected->core_size, actual->core_size);
+    TEST_ASSERT_EQUAL_OPCODE_ARRAY(expected->core, actual->core, expected->core_size);
+}
+
+#endif
@@ -24,8 +24,10 @@
 
 #include "../lib/unity/unity.h"
 #include "../src/mars.h"
-
-#define TEST_ASSERT_EQUAL_OPCODE_ARRAY TEST_ASSERT_EQUAL_UINT32_ARRAY
+#include "../src/engine.h"
+#include "../src/exec.h"
+#include "../src/utils.h"
+#include "fixtures.h"
 
 void test_create_mars_1(void) {
     mars m = create_mars(256, 64, 100);
@@ -34,7 +36,7 @@ void test_create_mars_1(void) {
     TEST_ASSERT_EQUAL(100, m.duration);
     TEST_ASSERT_EQUAL(0, m.elapsed);
     TEST_ASSERT_EQUAL(0, m.alive_count);
-    TEST_ASSERT_EQUAL(NULL, m.next_warrior);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, m.next_warrior);
 
     for(unsigned int i=0; i<256; i++) {
         TEST_ASSERT_EQUAL_UINT32(m.core[i], 0);
@@ -54,7 +56,7 @@ void test_create_mars_2(void) {
     TEST_ASSERT_EQUAL(50, m.duration);
     TEST_ASSERT_EQUAL(0, m.elapsed);
     TEST_ASSERT_EQUAL(0, m.alive_count);
-    TEST_ASSERT_EQUAL(NULL, m.next_warrior);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, m.next_warrior);
 
     for(unsigned int i=0; i<21; i++) {
         TEST_ASSERT_EQUAL_UINT32(m.core[i], 0);
@@ -68,98 +70,121 @@ void test_create_mars_2(void) {
 }
 
 void test_insert_warrior_empty(void) {
-    mars m;
-    warrior a;
+    mars m = create_mars(10, 5, 100);
 
-    insert_warrior(&m, &a);
+    unsigned int a = insert_warrior(&m, 3, 7);
+
+    TEST_ASSERT_EQUAL(3, m.warriors[a].id);
+    TEST_ASSERT_EQUAL(7, m.warriors[a].PC);
 
     // verify traversal order is a, a, ...
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+
+    destroy_mars(&m);
 }
 
 void test_insert_warrior(void) {
-    mars m;
-    warrior a, b, c, d;
+    mars m = create_mars(10, 5, 100);
+    unsigned int a, b, c, d;
 
     // insert, verify that newly inserted is always next to run
-    insert_warrior(&m, &a);
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
-    insert_warrior(&m, &b);
-    TEST_ASSERT_EQUAL(&b, m.next_warrior);
-    insert_warrior(&m, &c);
-    TEST_ASSERT_EQUAL(&c, m.next_warrior);
-    insert_warrior(&m, &d);
-    TEST_ASSERT_EQUAL(&d, m.next_warrior);
+    a = insert_warrior(&m, 0, 0);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    b = insert_warrior(&m, 1, 0);
+    TEST_ASSERT_EQUAL(b, m.next_warrior);
+    c = insert_warrior(&m, 2, 0);
+    TEST_ASSERT_EQUAL(c, m.next_warrior);
+    d = insert_warrior(&m, 3, 0);
+    TEST_ASSERT_EQUAL(d, m.next_warrior);
 
     // move from last inserted back to first
-    m.next_warrior = m.next_warrior->next;
+    m.next_warrior = m.warriors[m.next_warrior].next;
 
     // verify traversal order is a, b, c, d, a, ...
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&b, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&c, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&d, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(b, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(c, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(d, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+
+    destroy_mars(&m);
+}
+
+void test_insert_warrior_full(void) {
+    mars m = create_mars(10, 5, 100);
+
+    for(unsigned int i=0; i<MAX_WARRIORS; i++) {
+        TEST_ASSERT_EQUAL(i, insert_warrior(&m, i, 0));
+    }
+
+    TEST_ASSERT_EQUAL(NO_WARRIOR, insert_warrior(&m, 0, 0));
+    TEST_ASSERT_EQUAL(MAX_WARRIORS, m.alive_count);
+
+    destroy_mars(&m);
 }
 
 void test_remove_warrior_middle(void) {
-    mars m;
-    warrior a, b, c, d;
+    mars m = create_mars(10, 5, 100);
 
-    insert_warrior(&m, &a);
-    insert_warrior(&m, &b);
-    insert_warrior(&m, &c);
-    insert_warrior(&m, &d);
+    unsigned int a = insert_warrior(&m, 0, 0);
+    unsigned int b = insert_warrior(&m, 1, 0);
+    unsigned int c = insert_warrior(&m, 2, 0);
+    unsigned int d = insert_warrior(&m, 3, 0);
 
     // remove warrior that is not next to run
-    remove_warrior(&m, &b);
+    remove_warrior(&m, b);
 
     // verify sequence changes from d, a, b, c --> d, a, c
-    TEST_ASSERT_EQUAL(&d, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&c, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&d, m.next_warrior);
+    TEST_ASSERT_EQUAL(d, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(c, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(d, m.next_warrior);
+
+    destroy_mars(&m);
 }
 
 void test_remove_warrior_next(void) {
-    mars m;
-    warrior a, b, c, d;
+    mars m = create_mars(10, 5, 100);
 
-    insert_warrior(&m, &a);
-    insert_warrior(&m, &b);
-    insert_warrior(&m, &c);
-    insert_warrior(&m, &d);
+    unsigned int a = insert_warrior(&m, 0, 0);
+    unsigned int b = insert_warrior(&m, 1, 0);
+    unsigned int c = insert_warrior(&m, 2, 0);
+    unsigned int d = insert_warrior(&m, 3, 0);
 
-    remove_warrior(&m, &d);
+    remove_warrior(&m, d);
 
     // verify d, a, b, c --> a, b, c
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&b, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&c, m.next_warrior);
-    m.next_warrior = m.next_warrior->next;
-    TEST_ASSERT_EQUAL(&a, m.next_warrior);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(b, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(c, m.next_warrior);
+    m.next_warrior = m.warriors[m.next_warrior].next;
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+
+    destroy_mars(&m);
 }
 
 void test_remove_warrior_only(void) {
-    mars m;
-    warrior a;
+    mars m = create_mars(10, 5, 100);
+
+    unsigned int a = insert_warrior(&m, 0, 0);
 
-    insert_warrior(&m, &a);
+    remove_warrior(&m, a);
 
-    remove_warrior(&m, &a);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, m.next_warrior);
+    TEST_ASSERT_EQUAL(0, m.alive_count);
 
-    TEST_ASSERT_EQUAL(NULL, m.next_warrior);
+    destroy_mars(&m);
 }
 
 void test_load_program(void) {
@@ -174,10 +199,10 @@ void test_load_program(void) {
     load_program(&m, &prog, 0, 0);
     load_program(&m, &prog, 1, 2);
 
-    warrior* w = m.next_warrior;
+    warrior* w = &m.warriors[m.next_warrior];
     TEST_ASSERT_EQUAL(5, w->id);
     TEST_ASSERT_EQUAL(7, w->PC);
-    w = w->next;
+    w = &m.warriors[w->next];
     TEST_ASSERT_EQUAL(5, w->id);
     TEST_ASSERT_EQUAL(0, w->PC);
 
@@ -197,6 +222,33 @@ void test_load_program(void) {
     destroy_mars(&m);
 }
 
+void test_load_program_bounds(void) {
+    mars m = create_mars(10, 5, 100);
+    opcode code[MAX_PROGRAM_SIZE + 1] = { 0x15000001 };
+    program prog = prog_from_buffer(5, code, 3);
+
+    // past the end of the core, from a block or an offset
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_program(&m, &prog, 2, 0));
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_program(&m, &prog, 1, 3));
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_program(&m, &prog, 0, UINT_MAX));
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_program(&m, &prog, UINT_MAX, 0));
+    TEST_ASSERT_EQUAL(0, m.alive_count);
+
+    // a program longer than a block gets no offset
+    prog.size = 6;
+    TEST_ASSERT_EQUAL(UINT_MAX, get_offset(&m, &prog));
+
+    destroy_program(&prog);
+    destroy_mars(&m);
+
+    m = create_mars(1000, 500, 100);
+    prog = prog_from_buffer(5, code, MAX_PROGRAM_SIZE + 1);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_program(&m, &prog, 0, 0));
+
+    destroy_program(&prog);
+    destroy_mars(&m);
+}
+
 void test_get_operand_value(void) {
     mars m = create_mars(10, 5, 100);
     m.core[0] = (opcode) -5;
@@ -256,19 +308,125 @@ void test_get_operand_address(void) {
     destroy_mars(&m);
 }
 
+void test_predecode(void) {
+    mars m = create_mars(10, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // empty core decodes to DAT 0 0 pointing at itself
+    TEST_ASSERT_EQUAL(DAT_TYPE, m.decoded[3].type);
+    TEST_ASSERT_EQUAL(3, m.decoded[3].a_target);
+    TEST_ASSERT_EQUAL(3, m.decoded[3].b_target);
+
+    m.core[8] = 0x16003FFE; // MOV 3 @-2
+    predecode(&m, 8);
+
+    TEST_ASSERT_EQUAL(MOV_TYPE, m.decoded[8].type);
+    TEST_ASSERT_EQUAL(RELATIVE_MODE, m.decoded[8].a_mode);
+    TEST_ASSERT_EQUAL(INDIRECT_MODE, m.decoded[8].b_mode);
+    TEST_ASSERT_EQUAL(3, m.decoded[8].a);
+    TEST_ASSERT_EQUAL(-2, m.decoded[8].b);
+    TEST_ASSERT_EQUAL(1, m.decoded[8].a_target); // roll over top
+    TEST_ASSERT_EQUAL(6, m.decoded[8].b_target);
+
+    // a write made by an instruction refreshes the target's entry
+    m.core[0] = 0x15000001; // MOV 0 1
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(0x15000001, m.decoded[1].raw);
+    TEST_ASSERT_EQUAL(MOV_TYPE, m.decoded[1].type);
+    TEST_ASSERT_EQUAL(1, m.decoded[1].a_target);
+    TEST_ASSERT_EQUAL(2, m.decoded[1].b_target);
+
+    destroy_mars(&m);
+}
+
 // TESTS FOR MOV
 void test_mov_immediate_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // no address wrapping
+    m.core[0] = 0x11007002; // MOV #7 2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x11007002, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000007, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    // with address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x11FFF003; // MOV #-1 3
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 3;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(4, w->PC);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[0]);
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[2]);
+    TEST_ASSERT_EQUAL(0x11FFF003, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    destroy_mars(&m);
 }
 
 void test_mov_immediate_indirect(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // no address wrapping
+    m.core[0] = 0x12009001; // MOV #9 @1
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x12009001, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000003, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000009, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    // with address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x12005FFE; // MOV #5 @-2
+
+    w->PC = 4;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(0, w->PC);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000004, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000005, m.core[3]);
+    TEST_ASSERT_EQUAL(0x12005FFE, m.core[4]);
+
+    destroy_mars(&m);
 }
 
 void test_mov_relative_relative(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     // no address wrapping
     m.core[0] = 0x15004002; // MOV 4 2
@@ -277,7 +435,7 @@ void test_mov_relative_relative(void) {
     m.core[3] = 0x00000003; // DAT 3
     m.core[4] = 0x12345678; // DAT 4
 
-    w.PC = 0;
+    w->PC = 0;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x15004002, m.core[0]);
@@ -293,7 +451,7 @@ void test_mov_relative_relative(void) {
     m.core[3] = 0x00000003; // DAT 3
     m.core[4] = 0x00000004; // DAT 4
 
-    w.PC = 1;
+    w->PC = 1;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x1500AFFF, m.core[0]);
@@ -307,8 +465,7 @@ void test_mov_relative_relative(void) {
 
 void test_mov_indirect_relative(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     // no address wrapping
     m.core[0] = 0x00000000; // DAT 0
@@ -317,7 +474,7 @@ void test_mov_indirect_relative(void) {
     m.core[3] = 0x00000003; // DAT 3
     m.core[4] = 0x00000004; // DAT 4
 
-    w.PC = 2;
+    w->PC = 2;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0, m.core[0]);
@@ -333,7 +490,7 @@ void test_mov_indirect_relative(void) {
     m.core[3] = 0x00000003; // DAT 3
     m.core[4] = 0x00000004; // DAT 4
 
-    w.PC = 2;
+    w->PC = 2;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0, m.core[0]);
@@ -347,8 +504,7 @@ void test_mov_indirect_relative(void) {
 
 void test_mov_relative_indirect(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     // no address wrapping
     m.core[0] = 0x00000002; // DAT 2
@@ -357,7 +513,7 @@ void test_mov_relative_indirect(void) {
     m.core[3] = 0xFFFFFFFF; // DAT -1
     m.core[4] = 0x00000004; // DAT 4
 
-    w.PC = 2;
+    w->PC = 2;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -373,7 +529,7 @@ void test_mov_relative_indirect(void) {
     m.core[3] = 0x16008FFC; // MOV 8 @-4
     m.core[4] = 4;          // DAT 4
 
-    w.PC = 3;
+    w->PC = 3;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000000, m.core[0]);
@@ -387,8 +543,7 @@ void test_mov_relative_indirect(void) {
 
 void test_mov_indirect_indirect(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     // no address wrapping
     m.core[0] = 0x00000002; // DAT 2
@@ -397,7 +552,7 @@ void test_mov_indirect_indirect(void) {
     m.core[3] = 0xFFFFFFFF; // DAT -1
     m.core[4] = 0x00000004; // DAT 4
 
-    w.PC = 2;
+    w->PC = 2;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -413,7 +568,7 @@ void test_mov_indirect_indirect(void) {
     m.core[3] = 0x1A003FF7; // DAT @3 @-9
     m.core[4] = 0x00000003; // DAT 3
 
-    w.PC = 3;
+    w->PC = 3;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -428,8 +583,7 @@ void test_mov_indirect_indirect(void) {
 // TESTS FOR ADD
 void test_add_immediate_indirect(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     // no address wrapping
     m.core[0] = 0xFEDCBA98; // DAT -19088744
@@ -438,7 +592,7 @@ void test_add_immediate_indirect(void) {
     m.core[3] = 0xFFFFFFFF; // DAT -1
     m.core[4] = 0x00000104; // DAT 260
 
-    w.PC = 2;
+    w->PC = 2;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0xFEDCBA98, m.core[0]);
@@ -454,7 +608,7 @@ void test_add_immediate_indirect(void) {
     m.core[3] = 0x22004FFC; // ADD #4 @-4
     m.core[4] = 0x0000000A; // DAT 10
 
-    w.PC = 3;
+    w->PC = 3;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0xFEDCBA98, m.core[0]);
@@ -468,8 +622,7 @@ void test_add_immediate_indirect(void) {
 
 void test_add_immediate_relative(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   // no address wrapping
   m.core[0] = 0x10001000; // DAT 268435456
@@ -478,7 +631,7 @@ void test_add_immediate_relative(void) {
   m.core[3] = 0xFFFFFFFD; // DAT -3
   m.core[4] = 0x21FF0FFC; // ADD #-16 -4
 
-  w.PC = 4;
+  w->PC = 4;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x10000FF0, m.core[0]);
@@ -494,7 +647,7 @@ void test_add_immediate_relative(void) {
   m.core[3] = 0xFFFFFFFD; // DAT -3
   m.core[4] = 0x21FF0FFC; // ADD #-16 -4
 
-  w.PC = 0;
+  w->PC = 0;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x2100AFEF, m.core[0]);
@@ -508,8 +661,7 @@ void test_add_immediate_relative(void) {
 
 void test_add_relative_relative(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   // no address wrapping
   m.core[0] = 0x10001100; // DAT 268435456
@@ -518,7 +670,7 @@ void test_add_relative_relative(void) {
   m.core[3] = 0xFFFFFFFD; // DAT -3
   m.core[4] = 0x21FF0FFC; // ADD #-16 -4
 
-  w.PC = 2;
+  w->PC = 2;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x10001100, m.core[0]);
@@ -534,7 +686,7 @@ void test_add_relative_relative(void) {
   m.core[3] = 0xFFFFFFFD; // DAT -3
   m.core[4] = 0x21FF0FFC; // ADD #-16 -4
 
-  w.PC = 0;
+  w->PC = 0;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x25015010, m.core[0]);
@@ -548,8 +700,7 @@ void test_add_relative_relative(void) {
 
 void test_add_indirect_relative(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   // no address wrapping
   m.core[0] = 0x00000002; // DAT 1
@@ -558,7 +709,7 @@ void test_add_indirect_relative(void) {
   m.core[3] = 0x00000002; // DAT
   m.core[4] = 0x00000000; // DAT 0
 
-  w.PC = 1;
+  w->PC = 1;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -574,7 +725,7 @@ void test_add_indirect_relative(void) {
   m.core[3] = 0x29FF0005; // ADD @-16 5
   m.core[4] = 0x00000000; // DAT 0
 
-  w.PC = 3;
+  w->PC = 3;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000001, m.core[0]);
@@ -588,8 +739,7 @@ void test_add_indirect_relative(void) {
 
 void test_add_relative_indirect(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   m.core[0] = 0x00000002; // DAT 1
   m.core[1] = 0x26FFF006; // ADD -1 @6
@@ -597,7 +747,7 @@ void test_add_relative_indirect(void) {
   m.core[3] = 0x00000002; // DAT 2
   m.core[4] = 0x00000001; // DAT 1
 
-  w.PC = 1;
+  w->PC = 1;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -611,8 +761,7 @@ void test_add_relative_indirect(void) {
 
 void test_add_indirect_indirect(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   m.core[0] = 0x00000002; // DAT 1
   m.core[1] = 0x2AFFF008; // ADD @-1 @8
@@ -620,7 +769,7 @@ void test_add_indirect_indirect(void) {
   m.core[3] = 0x00000004; // DAT 4
   m.core[4] = 0x00000001; // DAT 1
 
-  w.PC = 1;
+  w->PC = 1;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -635,8 +784,7 @@ void test_add_indirect_indirect(void) {
 // TESTS FOR SUB
 void test_sub_immediate_indirect(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     m.core[0] = 0x00000002; // DAT 1
     m.core[1] = 0x32003001; // SUB #3 @1
@@ -644,7 +792,7 @@ void test_sub_immediate_indirect(void) {
     m.core[3] = 0x00000004; // DAT 4
     m.core[4] = 0x10101018; // DAT 269488152
 
-    w.PC = 1;
+    w->PC = 1;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -658,8 +806,7 @@ void test_sub_immediate_indirect(void) {
 
 void test_sub_immediate_relative(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     m.core[0] = 0x00000002; // DAT 1
     m.core[1] = 0x00000014; // DAT 20
@@ -667,7 +814,7 @@ void test_sub_immediate_relative(void) {
     m.core[3] = 0x31015003; // SUB #3 3
     m.core[4] = 0x10101018; // DAT 269488152
 
-    w.PC = 3;
+    w->PC = 3;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -681,8 +828,7 @@ void test_sub_immediate_relative(void) {
 
 void test_sub_relative_relative(void) {
     mars m = create_mars(5, 5, 100);
-    warrior w;
-    insert_warrior(&m, &w);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
     m.core[0] = 0x00000002; // DAT 1
     m.core[1] = 0x00000014; // DAT 20
@@ -690,7 +836,7 @@ void test_sub_relative_relative(void) {
     m.core[3] = 0x10101018; // DAT 269488152
     m.core[4] = 0x35FF8009; // SUB -8 9
 
-    w.PC = 4;
+    w->PC = 4;
     tick(&m);
 
     TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -704,8 +850,7 @@ void test_sub_relative_relative(void) {
 
 void test_sub_indirect_relative(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   m.core[0] = 0x39006FFE; // SUB @6 -2
   m.core[1] = 0x00000004; // DAT 4
@@ -713,7 +858,7 @@ void test_sub_indirect_relative(void) {
   m.core[3] = 0x10101018; // DAT 269488152
   m.core[4] = 0xFFFFFFFC; // DAT -4
 
-  w.PC = 0;
+  w->PC = 0;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x39006FFE, m.core[0]);
@@ -727,8 +872,7 @@ void test_sub_indirect_relative(void) {
 
 void test_sub_relative_indirect(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   m.core[0] = 0x00000004; // DAT 4
   m.core[1] = 0x36006FFE; // SUB 6 @-2
@@ -736,7 +880,7 @@ void test_sub_relative_indirect(void) {
   m.core[3] = 0x10101018; // DAT 269488152
   m.core[4] = 0xFFFFFFFC; // DAT -4
 
-  w.PC = 1;
+  w->PC = 1;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000004, m.core[0]);
@@ -750,8 +894,7 @@ void test_sub_relative_indirect(void) {
 
 void test_sub_indirect_indirect(void) {
   mars m = create_mars(5, 5, 100);
-  warrior w;
-  insert_warrior(&m, &w);
+  warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
   m.core[0] = 0x00000002; // DAT 2
   m.core[1] = 0x36006FFE; // SUB 6 @-2
@@ -759,7 +902,7 @@ void test_sub_indirect_indirect(void) {
   m.core[3] = 0xFFFFFFFF; // DAT 269488152
   m.core[4] = 0x00000001; // DAT 1
 
-  w.PC = 2;
+  w->PC = 2;
   tick(&m);
 
   TEST_ASSERT_EQUAL(0x00000002, m.core[0]);
@@ -773,92 +916,1444 @@ void test_sub_indirect_indirect(void) {
 
 // TESTS FOR JMP
 void test_jmp_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // no address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x41000002; // JMP 2
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 1;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    // with address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x41000FFC; // JMP -4
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 3;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(4, w->PC);
+
+    // onto the first cell
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x41000003; // JMP 3
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 2;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(0, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmp_indirect(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // no address wrapping
+    m.core[0] = 0x42000002; // JMP @2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000003; // DAT 3
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    // with address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0xFFFFFFFD; // DAT -3
+    m.core[4] = 0x42000FFF; // JMP @-1
+
+    w->PC = 4;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 // TESTS FOR JMZ
 void test_jmz_immediate_indirect(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x52000001; // JMZ #0 @1
+    m.core[2] = 0x00000002; // DAT 2
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 1;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x52005001; // JMZ #5 @1
+    m.core[2] = 0x00000002; // DAT 2
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 1;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmz_immediate_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x51000002; // JMZ #0 2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x51001002; // JMZ #1 2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmz_relative_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x55001003; // JMZ 1 3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x55001003; // JMZ 1 3
+    m.core[1] = 0x00000007; // DAT 7
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmz_indirect_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x59001003; // JMZ @1 3
+    m.core[1] = 0x00000002; // DAT 2
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x59001003; // JMZ @1 3
+    m.core[1] = 0x00000002; // DAT 2
+    m.core[2] = 0x00000001; // DAT 1
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmz_relative_indirect(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x56001002; // JMZ 1 @2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(4, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x56001002; // JMZ 1 @2
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 void test_jmz_indirect_indirect(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // zero, jump
+    m.core[0] = 0x5A001002; // JMZ @1 @2
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000001; // DAT 1
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // non-zero, no jump
+    m.core[0] = 0x5A001002; // JMZ @1 @2
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000001; // DAT 1
+    m.core[3] = 0x00000006; // DAT 6
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
 }
 
 // TESTS FOR DJZ
 void test_djz_relative_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // one, jump
+    m.core[0] = 0x65001003; // DJZ 1 3
+    m.core[1] = 0x00000001; // DAT 1
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+    TEST_ASSERT_EQUAL(0x65001003, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000001, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    // non-one, no jump
+    m.core[0] = 0x65001003; // DJZ 1 3
+    m.core[1] = 0x00000002; // DAT 2
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x65001003, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000002, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    destroy_mars(&m);
 }
 
 void test_djz_indirect_relative(void) {
-    TEST_IGNORE();
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // one, jump
+    m.core[0] = 0x69001003; // DJZ @1 3
+    m.core[1] = 0x00000002; // DAT 2
+    m.core[2] = 0x00000001; // DAT 1
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+    TEST_ASSERT_EQUAL(0x69001003, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000002, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000001, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    // non-one, no jump
+    m.core[0] = 0x69001003; // DJZ @1 3
+    m.core[1] = 0x00000002; // DAT 2
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x69001003, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000002, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    destroy_mars(&m);
 }
 
 void test_djz_relative_indirect(void) {
-    TEST_IGNORE();
-}
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
-void test_djz_indirect_indirect(void) {
-    TEST_IGNORE();
-}
+    // one, jump
+    m.core[0] = 0x66001002; // DJZ 1 @2
+    m.core[1] = 0x00000001; // DAT 1
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
 
-// TESTS FOR CMP
-void test_cmp_immediate_immediate(void) {
-  TEST_IGNORE();
-}
+    w->PC = 0;
+    tick(&m);
 
-void test_cmp_immediate_indirect(void) {
-    TEST_IGNORE();
-}
+    TEST_ASSERT_EQUAL(4, w->PC);
+    TEST_ASSERT_EQUAL(0x66001002, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000001, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000004, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
 
-void test_cmp_immediate_relative(void) {
-    TEST_IGNORE();
-}
+    // non-one, no jump
+    m.core[0] = 0x66001002; // DJZ 1 @2
+    m.core[1] = 0x00000005; // DAT 5
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
 
-void test_cmp_relative_immediate(void) {
-  TEST_IGNORE();
-}
+    w->PC = 0;
+    tick(&m);
 
-void test_cmp_relative_relative(void) {
-    TEST_IGNORE();
-}
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x66001002, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000005, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000004, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
 
-void test_cmp_relative_indirect(void) {
-    TEST_IGNORE();
+    destroy_mars(&m);
 }
 
-void test_cmp_indirect_immediate(void) {
-    TEST_IGNORE();
-}
+void test_djz_indirect_indirect(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
 
-void test_cmp_indirect_relative(void) {
-    TEST_IGNORE();
-}
+    // one, jump
+    m.core[0] = 0x6A001002; // DJZ @1 @2
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000002; // DAT 2
+    m.core[3] = 0x00000001; // DAT 1
+    m.core[4] = 0x00000000; // DAT 0
 
-void test_cmp_indirect_indirect(void) {
-    TEST_IGNORE();
-}
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+    TEST_ASSERT_EQUAL(0x6A001002, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000003, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000002, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000001, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
 
+    // non-one, no jump
+    m.core[0] = 0x6A001002; // DJZ @1 @2
+    m.core[1] = 0x00000003; // DAT 3
+    m.core[2] = 0x00000002; // DAT 2
+    m.core[3] = 0x00000003; // DAT 3
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+    TEST_ASSERT_EQUAL(0x6A001002, m.core[0]);
+    TEST_ASSERT_EQUAL(0x00000003, m.core[1]);
+    TEST_ASSERT_EQUAL(0x00000002, m.core[2]);
+    TEST_ASSERT_EQUAL(0x00000003, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000000, m.core[4]);
+
+    destroy_mars(&m);
+}
+
+// TESTS FOR CMP
+void test_cmp_immediate_immediate(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x70003003; // CMP #3 #3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x70003004; // CMP #3 #4
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    // skip with address wrapping
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000000; // DAT 0
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x70001002; // CMP #1 #2
+
+    w->PC = 4;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_immediate_indirect(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x72007002; // CMP #7 @2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000003; // DAT 3
+    m.core[3] = 0x00000007; // DAT 7
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x72007002; // CMP #7 @2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000003; // DAT 3
+    m.core[3] = 0x00000001; // DAT 1
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_immediate_relative(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x71007002; // CMP #7 2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000007; // DAT 7
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x71007002; // CMP #7 2
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000008; // DAT 8
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_relative_immediate(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x74002007; // CMP 2 #7
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000007; // DAT 7
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x74002007; // CMP 2 #7
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0xFFFFFFF9; // DAT -7
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_relative_relative(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x75002003; // CMP 2 3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000009; // DAT 9
+    m.core[3] = 0x00000009; // DAT 9
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x75002003; // CMP 2 3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000009; // DAT 9
+    m.core[3] = 0x00000008; // DAT 8
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_relative_indirect(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x76002003; // CMP 2 @3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000006; // DAT 6
+    m.core[3] = 0x00000004; // DAT 4
+    m.core[4] = 0x00000006; // DAT 6
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x76002003; // CMP 2 @3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000006; // DAT 6
+    m.core[3] = 0x00000004; // DAT 4
+    m.core[4] = 0x00000005; // DAT 5
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_indirect_immediate(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x78002007; // CMP @2 #7
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000007; // DAT 7
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x78002007; // CMP @2 #7
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000000; // DAT 0
+    m.core[4] = 0x00000000; // DAT 0
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_indirect_relative(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x79002003; // CMP @2 3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000005; // DAT 5
+    m.core[4] = 0x00000005; // DAT 5
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x79002003; // CMP @2 3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0x00000005; // DAT 5
+    m.core[4] = 0x00000006; // DAT 6
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(2, w->PC);
+
+    destroy_mars(&m);
+}
+
+void test_cmp_indirect_indirect(void) {
+    mars m = create_mars(5, 5, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    // equal, no skip
+    m.core[0] = 0x7A002003; // CMP @2 @3
+    m.core[1] = 0x00000000; // DAT 0
+    m.core[2] = 0x00000004; // DAT 4
+    m.core[3] = 0xFFFFFFFF; // DAT -1
+    m.core[4] = 0x00000002; // DAT 2
+
+    w->PC = 0;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(1, w->PC);
+
+    // not equal, skip
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x7A002003; // CMP @2 @3
+    m.core[2] = 0x00000003; // DAT 3
+    m.core[3] = 0x00000001; // DAT 1
+    m.core[4] = 0xFFFFFFFF; // DAT -1
+
+    w->PC = 1;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(3, w->PC);
+
+    destroy_mars(&m);
+}
+
+// TESTS FOR ILLEGAL INSTRUCTIONS
+void test_illegal_instructions(void) {
+    mars m = create_mars(5, 5, 100);
+    unsigned int a = insert_warrior(&m, 0, 3);
+    unsigned int b = insert_warrior(&m, 1, 1);
+    unsigned int c = insert_warrior(&m, 2, 2);
+    insert_warrior(&m, 3, 0);
+
+    m.core[0] = 0x00000000; // DAT 0
+    m.core[1] = 0x10001002; // MOV #1 #2
+    m.core[2] = 0x1D001001; // MOV with an invalid A-mode
+    m.core[3] = 0x41000FFD; // JMP -3
+    m.core[4] = 0x00000004; // DAT 4
+
+    // order is d, a, b, c; every warrior but a dies without writing
+    tick(&m);
+    TEST_ASSERT_EQUAL(3, m.alive_count);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+    tick(&m);
+    TEST_ASSERT_EQUAL(0, m.warriors[a].PC);
+    TEST_ASSERT_EQUAL(b, m.next_warrior);
+    tick(&m);
+    TEST_ASSERT_EQUAL(c, m.next_warrior);
+    tick(&m);
+    TEST_ASSERT_EQUAL(1, m.alive_count);
+    TEST_ASSERT_EQUAL(a, m.next_warrior);
+
+    TEST_ASSERT_EQUAL(0x00000000, m.core[0]);
+    TEST_ASSERT_EQUAL(0x10001002, m.core[1]);
+    TEST_ASSERT_EQUAL(0x1D001001, m.core[2]);
+    TEST_ASSERT_EQUAL(0x41000FFD, m.core[3]);
+    TEST_ASSERT_EQUAL(0x00000004, m.core[4]);
+    TEST_ASSERT_EQUAL(4, m.elapsed);
+
+    // the last warrior dying leaves the mars empty
+    tick(&m);
+    TEST_ASSERT_EQUAL(0, m.alive_count);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, m.next_warrior);
+
+    // each death is logged with the instruction that caused it
+    unsigned int ids[] = { 3, 1, 2, 0 };
+    unsigned int pcs[] = { 0, 1, 2, 0 };
+    unsigned int ticks[] = { 0, 2, 3, 4 };
+    opcode instructions[] = { 0x00000000, 0x10001002, 0x1D001001, 0x00000000 };
+
+    TEST_ASSERT_EQUAL(4, m.event_count);
+
+    for(unsigned int i=0; i<4; i++) {
+        const death_event* event = get_event(&m, i);
+        TEST_ASSERT_EQUAL(ids[i], event->id);
+        TEST_ASSERT_EQUAL(pcs[i], event->PC);
+        TEST_ASSERT_EQUAL(ticks[i], event->tick);
+        TEST_ASSERT_EQUAL_UINT32(instructions[i], event->instruction);
+    }
+
+    TEST_ASSERT_NULL(get_event(&m, 4));
+
+    destroy_mars(&m);
+}
+
+void test_event_log(void) {
+    mars m = create_mars(10, 5, 1000);
+    unsigned int deaths = EVENT_LOG_SIZE + 44;
+
+    for(unsigned int i=0; i<deaths; i++) {
+        insert_warrior(&m, i, 0);
+    }
+
+    for(unsigned int i=0; i<deaths; i++) {
+        tick(&m);
+    }
+
+    // only the most recent deaths are kept
+    TEST_ASSERT_EQUAL(deaths, m.event_count);
+    TEST_ASSERT_NULL(get_event(&m, 43));
+    TEST_ASSERT_EQUAL(44, get_event(&m, 44)->tick);
+    TEST_ASSERT_EQUAL(deaths - 1, get_event(&m, deaths - 1)->tick);
+
+    destroy_mars(&m);
+}
+
+// TESTS FOR PLAY
+void test_play_winner(void) {
+    opcode dat[] = { 0x00000000 };
+    opcode jmp[] = { 0x41000000 }; // JMP 0
+
+    for(unsigned int fast=0; fast<2; fast++) {
+        mars m = create_mars(100, 10, 1000);
+        warrior *a, *b;
+        battle_result result;
+
+        place(&m, &a, DWARF, 4, 0);
+        place(&m, &b, dat, 1, 50);
+        a->id = 3;
+        b->id = 4;
+
+        // order is b, a: b dies on its first turn, ending the battle
+        int winner = fast ? play_fast(&m, &result) : play(&m, &result);
+
+        TEST_ASSERT_EQUAL(3, winner);
+        TEST_ASSERT_EQUAL(3, result.winner);
+        TEST_ASSERT_EQUAL(1, result.elapsed);
+        TEST_ASSERT_EQUAL(1, m.elapsed);
+        TEST_ASSERT_EQUAL(1, result.death_count);
+        TEST_ASSERT_EQUAL(4, result.death_ids[0]);
+        TEST_ASSERT_EQUAL(0, result.death_ticks[0]);
+
+        destroy_mars(&m);
+    }
+
+    for(unsigned int fast=0; fast<2; fast++) {
+        mars m = create_mars(100, 10, 1000);
+        warrior *a, *b;
+        battle_result result;
+
+        place(&m, &a, jmp, 1, 0);
+        place(&m, &b, jmp, 1, 50);
+
+        // neither warrior can die, so the battle is a draw
+        int winner = fast ? play_fast(&m, &result) : play(&m, &result);
+
+        TEST_ASSERT_EQUAL(-1, winner);
+        TEST_ASSERT_EQUAL(-1, result.winner);
+        TEST_ASSERT_EQUAL(1000, result.elapsed);
+        TEST_ASSERT_EQUAL(0, result.death_count);
+
+        destroy_mars(&m);
+    }
+}
+
+void test_play_fast_matches_play(void) {
+    opcode* programs[] = { IMP, DWARF, GEMINI };
+    unsigned int sizes[] = { 1, 4, 10 };
+
+    for(unsigned int i=0; i<3; i++) {
+        for(unsigned int j=0; j<3; j++) {
+            mars slow = create_mars(800, 100, 4000);
+            mars fast = create_mars(800, 100, 4000);
+            warrior *slow_a, *slow_b, *fast_a, *fast_b;
+
+            battle_result slow_result, fast_result;
+
+            place(&slow, &slow_a, programs[i], sizes[i], 10);
+            place(&slow, &slow_b, programs[j], sizes[j], 437);
+            place(&fast, &fast_a, programs[i], sizes[i], 10);
+            place(&fast, &fast_b, programs[j], sizes[j], 437);
+            slow_a->id = fast_a->id = 1;
+            slow_b->id = fast_b->id = 2;
+
+            TEST_ASSERT_EQUAL(play(&slow, &slow_result),
+                              play_fast(&fast, &fast_result));
+            TEST_ASSERT_EQUAL(slow_result.winner, fast_result.winner);
+            TEST_ASSERT_EQUAL(slow_result.elapsed, fast_result.elapsed);
+            TEST_ASSERT_EQUAL(slow_result.death_count, fast_result.death_count);
+
+            for(unsigned int k=0; k<slow_result.death_count; k++) {
+                TEST_ASSERT_EQUAL(slow_result.death_ids[k], fast_result.death_ids[k]);
+                TEST_ASSERT_EQUAL(slow_result.death_ticks[k], fast_result.death_ticks[k]);
+            }
+
+            assert_same_state(&slow, &fast);
+
+            destroy_mars(&slow);
+            destroy_mars(&fast);
+        }
+    }
+}
+
+void test_fixed_size_engines(void) {
+    unsigned int core_sizes[] = { 8000, 8192, 4096, 10, 5 };
+
+    for(unsigned int i=0; i<5; i++) {
+        unsigned int size = core_sizes[i];
+        mars fixed = create_mars(size, 5, 3000);
+        mars generic = create_mars(size, 5, 3000);
+        warrior *fixed_a, *fixed_b, *generic_a, *generic_b;
+
+        TEST_ASSERT_EQUAL(size, fixed.engine->core_size);
+        generic.engine = &generic_engine;
+
+        place(&fixed, &fixed_a, DWARF, 4, 0);
+        place(&fixed, &fixed_b, IMP, 1, size / 2);
+        place(&generic, &generic_a, DWARF, 4, 0);
+        place(&generic, &generic_b, IMP, 1, size / 2);
+
+        play_fast(&fixed, NULL);
+        play_fast(&generic, NULL);
+
+        assert_same_state(&generic, &fixed);
+
+        destroy_mars(&fixed);
+        destroy_mars(&generic);
+    }
+
+    // sizes without a specialization fall back to the generic engine
+    TEST_ASSERT_EQUAL(&generic_engine, select_engine(21));
+}
+
+void test_cycle_detection(void) {
+    battle_result results[2];
+    unsigned int elapsed[2];
+
+    for(unsigned int fast=0; fast<2; fast++) {
+        mars m = create_mars(800, 100, 1000000);
+        warrior *a, *b;
+
+        place(&m, &a, IMP, 1, 10);
+        place(&m, &b, IMP, 1, 437);
+        a->id = 1;
+        b->id = 2;
+        enable_cycle_detection(&m);
+
+        // once the imps have filled the core only their PCs change, and
+        // those repeat every 800 rounds
+        int winner = fast ? play_fast(&m, &results[fast]) : play(&m, &results[fast]);
+
+        TEST_ASSERT_EQUAL(-1, winner);
+        TEST_ASSERT_TRUE(results[fast].repeated);
+        TEST_ASSERT_TRUE(results[fast].elapsed < 20000);
+        elapsed[fast] = m.elapsed;
+
+        // the incrementally updated hash matches one computed from scratch
+        uint64_t hash = state_hash(&m);
+        enable_cycle_detection(&m);
+        TEST_ASSERT_TRUE(hash == state_hash(&m));
+
+        destroy_mars(&m);
+    }
+
+    TEST_ASSERT_EQUAL(elapsed[0], elapsed[1]);
+    TEST_ASSERT_EQUAL(results[0].elapsed, results[1].elapsed);
+
+    // two warriors jumping to themselves never change the state, so the
+    // battle repeats at the first sample, CYCLE_CHECK_ROUNDS rounds in, on
+    // either loop; unlike imps, they are never skipped through
+    opcode STAY[] = { 0x41000000 };
+
+    for(unsigned int fast=0; fast<2; fast++) {
+        mars m = create_mars(800, 100, 100000);
+        warrior *a, *b;
+        battle_result result;
+
+        place(&m, &a, STAY, 1, 10);
+        place(&m, &b, STAY, 1, 437);
+        a->id = 1;
+        b->id = 2;
+        enable_cycle_detection(&m);
+
+        int winner = fast ? play_fast(&m, &result) : play(&m, &result);
+
+        TEST_ASSERT_EQUAL(-1, winner);
+        TEST_ASSERT_EQUAL(-1, result.winner);
+        TEST_ASSERT_TRUE(result.repeated);
+        TEST_ASSERT_EQUAL(CYCLE_CHECK_ROUNDS * 2, result.elapsed);
+        TEST_ASSERT_EQUAL(2, m.alive_count);
+
+        destroy_mars(&m);
+    }
+
+    // a lone warrior wins whether or not its loop is detected
+    for(unsigned int detect=0; detect<2; detect++) {
+        mars m = create_mars(800, 100, 100000);
+        warrior* a;
+        battle_result result;
+
+        place(&m, &a, IMP, 1, 10);
+        a->id = 3;
+
+        if(detect) {
+            enable_cycle_detection(&m);
+        }
+
+        TEST_ASSERT_EQUAL(3, play_fast(&m, &result));
+        TEST_ASSERT_EQUAL(3, result.winner);
+        TEST_ASSERT_EQUAL(detect ? 1 : 0, result.repeated);
+
+        destroy_mars(&m);
+    }
+
+    // battles which end in a death are unaffected
+    opcode* programs[] = { DWARF, GEMINI };
+    unsigned int sizes[] = { 4, 10 };
+
+    for(unsigned int i=0; i<2; i++) {
+        mars plain = create_mars(800, 100, 4000);
+        mars watched = create_mars(800, 100, 4000);
+        warrior *plain_a, *plain_b, *watched_a, *watched_b;
+        battle_result plain_result, watched_result;
+
+        place(&plain, &plain_a, programs[i], sizes[i], 10);
+        place(&plain, &plain_b, IMP, 1, 437);
+        place(&watched, &watched_a, programs[i], sizes[i], 10);
+        place(&watched, &watched_b, IMP, 1, 437);
+        enable_cycle_detection(&watched);
+
+        play_fast(&plain, &plain_result);
+        play_fast(&watched, &watched_result);
+
+        TEST_ASSERT_FALSE(watched_result.repeated);
+        TEST_ASSERT_EQUAL(plain_result.winner, watched_result.winner);
+        TEST_ASSERT_EQUAL(plain_result.elapsed, watched_result.elapsed);
+        TEST_ASSERT_EQUAL_OPCODE_ARRAY(plain.core, watched.core, 800);
+
+        destroy_mars(&plain);
+        destroy_mars(&watched);
+    }
+}
+
+void test_run_cycles(void) {
+    mars m = create_mars(800, 100, 100000);
+    mars twin = create_mars(800, 100, 100000);
+    warrior *a, *b, *twin_a, *twin_b;
+
+    place(&m, &a, IMP, 1, 10);
+    place(&m, &b, IMP, 1, 437);
+    place(&twin, &twin_a, IMP, 1, 10);
+    place(&twin, &twin_b, IMP, 1, 437);
+
+    TEST_ASSERT_EQUAL(STOP_LIMIT, run_cycles(&m, 100, NULL));
+    TEST_ASSERT_EQUAL(100, m.elapsed);
+
+    run_hooks hooks = { 30, NO_ADDRESS, NO_ADDRESS };
+    TEST_ASSERT_EQUAL(STOP_INTERVAL, run_cycles(&m, 1000, &hooks));
+    TEST_ASSERT_EQUAL(120, m.elapsed);
+
+    // stops right after the first write to the watched address
+    hooks = (run_hooks) { 0, 200, NO_ADDRESS };
+    TEST_ASSERT_EQUAL(STOP_WATCH, run_cycles(&m, 1000, &hooks));
+
+    while(twin.core[200] == 0) {
+        tick(&twin);
+    }
+
+    TEST_ASSERT_EQUAL(twin.elapsed, m.elapsed);
+
+    // stops right before an instruction at the breakpoint is executed
+    hooks = (run_hooks) { 0, NO_ADDRESS, 500 };
+    TEST_ASSERT_EQUAL(STOP_BREAKPOINT, run_cycles(&m, 1000, &hooks));
+
+    while(twin.warriors[twin.next_warrior].PC != 500) {
+        tick(&twin);
+    }
+
+    TEST_ASSERT_EQUAL(twin.elapsed, m.elapsed);
+    TEST_ASSERT_EQUAL(500, m.warriors[m.next_warrior].PC);
+
+    // a stopped run resumes past the breakpoint
+    TEST_ASSERT_EQUAL(STOP_LIMIT, run_cycles(&m, 10, &hooks));
+    TEST_ASSERT_EQUAL(twin.elapsed + 10, m.elapsed);
+
+    for(unsigned int i=0; i<10; i++) {
+        tick(&twin);
+    }
+
+    TEST_ASSERT_EQUAL(a->PC, twin_a->PC);
+    TEST_ASSERT_EQUAL(b->PC, twin_b->PC);
+    TEST_ASSERT_EQUAL_OPCODE_ARRAY(twin.core, m.core, 800);
+
+    destroy_mars(&m);
+    destroy_mars(&twin);
+
+    // deaths stop the run, and the last one ends the battle
+    opcode dat[] = { 0x00000000 };
+    opcode jmp[] = { 0x41000000 }; // JMP 0
+    warrior *c;
+
+    m = create_mars(100, 10, 1000);
+    place(&m, &a, dat, 1, 0);
+    place(&m, &b, dat, 1, 30);
+    place(&m, &c, jmp, 1, 60);
+
+    TEST_ASSERT_EQUAL(STOP_DEATH, run_cycles(&m, 1000, NULL));
+    TEST_ASSERT_EQUAL(2, m.alive_count);
+    TEST_ASSERT_EQUAL(STOP_END, run_cycles(&m, 1000, NULL));
+    TEST_ASSERT_EQUAL(1, m.alive_count);
+
+    destroy_mars(&m);
+
+    // a battle run in chunks ends just like one run by play()
+    m = create_mars(800, 100, 20000);
+    twin = create_mars(800, 100, 20000);
+    place(&m, &a, DWARF, 4, 10);
+    place(&m, &b, GEMINI, 10, 437);
+    place(&twin, &twin_a, DWARF, 4, 10);
+    place(&twin, &twin_b, GEMINI, 10, 437);
+
+    hooks = (run_hooks) { 1000, 13, NO_ADDRESS };
+
+    while(run_cycles(&m, 37, &hooks) != STOP_END);
+
+    play(&twin, NULL);
+
+    assert_same_state(&twin, &m);
+
+    destroy_mars(&m);
+    destroy_mars(&twin);
+}
+
+void test_imp_fast_forward(void) {
+    // a warrior which turns into an imp, and one which dies at once, leaving
+    // only imps behind
+    opcode LATE_IMP[] = { 0x41000001, 0x15000001 };
+    opcode DIES[] = { 0x00000000 };
+
+    for(unsigned int detect=0; detect<2; detect++) {
+        mars skipped = create_mars(801, 100, 20011);
+        mars stepped = create_mars(801, 100, 20011);
+        warrior* w;
+        battle_result result;
+
+        place(&skipped, &w, IMP, 1, 10);
+        place(&skipped, &w, LATE_IMP, 2, 300);
+        place(&skipped, &w, DIES, 1, 500);
+        place(&skipped, &w, IMP, 1, 795);
+        place(&stepped, &w, IMP, 1, 10);
+        place(&stepped, &w, LATE_IMP, 2, 300);
+        place(&stepped, &w, DIES, 1, 500);
+        place(&stepped, &w, IMP, 1, 795);
+
+        if(detect) {
+            enable_cycle_detection(&skipped);
+        }
+
+        TEST_ASSERT_EQUAL(-1, play_fast(&skipped, &result));
+        TEST_ASSERT_EQUAL(1, result.death_count);
+
+        // run_cycles() never skips, so it plays out every imp turn
+        while(stepped.elapsed < stepped.duration) {
+            run_cycles(&stepped, stepped.duration, NULL);
+        }
+
+        // the imps' loop of 2403 ticks is too long for samples taken every
+        // 192 ticks to repeat before the battle ends
+        TEST_ASSERT_FALSE(result.repeated);
+        TEST_ASSERT_EQUAL(stepped.elapsed, skipped.elapsed);
+        TEST_ASSERT_EQUAL(3, skipped.alive_count);
+
+        if(detect) {
+            uint64_t hash = skipped.core_hash;
+            enable_cycle_detection(&skipped);
+            TEST_ASSERT_TRUE(hash == skipped.core_hash);
+        }
+
+        TEST_ASSERT_EQUAL_OPCODE_ARRAY(stepped.core, skipped.core, 801);
+        TEST_ASSERT_EQUAL(stepped.next_warrior, skipped.next_warrior);
+
+        for(unsigned int i=0; i<4; i++) {
+            TEST_ASSERT_EQUAL(stepped.warriors[i].PC, skipped.warriors[i].PC);
+        }
+
+        destroy_mars(&skipped);
+        destroy_mars(&stepped);
+    }
+}
+
+/* Checks that the given mars is as empty as a fresh one. */
+void assert_empty(mars* m) {
+    TEST_ASSERT_EQUAL(0, m->elapsed);
+    TEST_ASSERT_EQUAL(0, m->alive_count);
+    TEST_ASSERT_EQUAL(0, m->warrior_count);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, m->next_warrior);
+    TEST_ASSERT_EQUAL(0, m->event_count);
+
+    for(unsigned int i=0; i<m->core_size; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0, m->core[i]);
+        TEST_ASSERT_EQUAL_HEX32(0, m->decoded[i].raw);
+        TEST_ASSERT_EQUAL(i, m->decoded[i].b_target);
+    }
+
+    for(unsigned int i=0; i<m->core_size / m->block_size; i++) {
+        TEST_ASSERT_FALSE(m->blocks[i]);
+    }
+}
+
+void test_reset_mars(void) {
+    // the second core is large enough to be mapped, and the imp leaves a long
+    // enough trail in it for reset_mars() to give pages back with madvise()
+    unsigned int sizes[] = { 8000, 400000 };
+    program dwarf = prog_from_buffer(0, DWARF, 4);
+    program imp = prog_from_buffer(1, IMP, 1);
+
+    for(unsigned int s=0; s<2; s++) {
+        mars m = create_mars(sizes[s], 100, 20000);
+        battle_result first, again;
+
+        for(unsigned int round=0; round<3; round++) {
+            battle_result* result = round == 0 ? &first : &again;
+
+            load_program(&m, &dwarf, 3, 7);
+            load_program(&m, &imp, 40, 0);
+            enable_cycle_detection(&m);
+            play_fast(&m, result);
+
+            TEST_ASSERT_EQUAL(first.winner, result->winner);
+            TEST_ASSERT_EQUAL(first.elapsed, result->elapsed);
+            TEST_ASSERT_EQUAL(first.death_count, result->death_count);
+
+            reset_mars(&m);
+            assert_empty(&m);
+            TEST_ASSERT_EQUAL(0, m.write_barrier & BARRIER_HASH);
+        }
+
+        destroy_mars(&m);
+    }
+
+    destroy_program(&dwarf);
+    destroy_program(&imp);
+}
+
+void test_mars_pool(void) {
+    mars_pool pool = create_pool(800, 100, 1000);
+    mars* held[MARS_POOL_SIZE + 1];
+    program imp = prog_from_buffer(0, IMP, 1);
+
+    mars* m = acquire_mars(&pool);
+    TEST_ASSERT_EQUAL(800, m->core_size);
+    load_program(m, &imp, 2, 0);
+    play_fast(m, NULL);
+    release_mars(&pool, m);
+    TEST_ASSERT_EQUAL(1, pool.count);
+
+    // the idle mars is handed out again, emptied
+    TEST_ASSERT_TRUE(acquire_mars(&pool) == m);
+    assert_empty(m);
+    TEST_ASSERT_EQUAL(0, pool.count);
+    release_mars(&pool, m);
+
+    // the pool keeps at most MARS_POOL_SIZE idle
+    for(unsigned int i=0; i<MARS_POOL_SIZE + 1; i++) {
+        held[i] = acquire_mars(&pool);
+    }
+
+    for(unsigned int i=0; i<MARS_POOL_SIZE + 1; i++) {
+        release_mars(&pool, held[i]);
+    }
+
+    TEST_ASSERT_EQUAL(MARS_POOL_SIZE, pool.count);
+
+    destroy_pool(&pool);
+    TEST_ASSERT_EQUAL(0, pool.count);
+    destroy_program(&imp);
+}
+
+void test_seed_mars(void) {
+    mars a = create_mars(8000, 100, 20000);
+    mars b = create_mars(8000, 100, 20000);
+    program dwarf = prog_from_buffer(0, DWARF, 4);
+    program imp = prog_from_buffer(1, IMP, 1);
+    battle_result result;
+
+    // a new mars is only seeded at random once it first places a warrior,
+    // and a reset leaves an unseeded mars unseeded
+    TEST_ASSERT_FALSE(a.seeded);
+    reset_mars(&a);
+    TEST_ASSERT_FALSE(a.seeded);
+    get_block(&a);
+    TEST_ASSERT_TRUE(a.seeded);
+    reset_mars(&a);
+
+    seed_mars(&a, 12345);
+    seed_mars(&b, 12345);
+    TEST_ASSERT_TRUE(a.seeded);
+    TEST_ASSERT_TRUE(a.seed == 12345);
+
+    // the same seed places warriors the same way, on a fresh mars or after
+    // a reset, which reseeds each from its own generator
+    for(unsigned int round=0; round<3; round++) {
+        for(unsigned int i=0; i<20; i++) {
+            TEST_ASSERT_EQUAL(get_block(&a), get_block(&b));
+            TEST_ASSERT_EQUAL(get_offset(&a, &dwarf), get_offset(&b, &dwarf));
+        }
+
+        TEST_ASSERT_TRUE(a.seed == b.seed);
+        reset_mars(&a);
+        reset_mars(&b);
+    }
+
+    // every block is handed out once before the core is full
+    for(unsigned int i=0; i<80; i++) {
+        unsigned int block = get_block(&a);
+        TEST_ASSERT_TRUE(block < 80);
+    }
+
+    TEST_ASSERT_EQUAL(UINT_MAX, get_block(&a));
+
+    // battle results record the seed their warriors were placed from
+    uint64_t seed = b.seed;
+    unsigned int block = get_block(&b);
+    unsigned int offset = get_offset(&b, &dwarf);
+    load_program(&b, &dwarf, block, offset);
+    block = get_block(&b);
+    offset = get_offset(&b, &imp);
+    load_program(&b, &imp, block, offset);
+    play_fast(&b, &result);
+    TEST_ASSERT_TRUE(result.seed == seed);
+
+    destroy_program(&dwarf);
+    destroy_program(&imp);
+    destroy_mars(&a);
+    destroy_mars(&b);
+}
+
+void test_battle_seed(void) {
+    // known answers of Philox4x32-10 from its reference implementation
+    const uint32_t zeros[4] = { 0, 0, 0, 0 };
+    const uint32_t ones[4] = { ~0u, ~0u, ~0u, ~0u };
+    const uint32_t pi[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+    const uint32_t pi_key[2] = { 0xa4093822, 0x299f31d0 };
+    const uint32_t zeros_out[4] = { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+    const uint32_t ones_out[4] = { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd };
+    const uint32_t pi_out[4] = { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 };
+    uint32_t out[4];
+
+    philox(zeros, zeros, out);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(zeros_out, out, 4);
+    philox(ones, ones, out);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(ones_out, out, 4);
+    philox(pi, pi_key, out);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(pi_out, out, 4);
+
+    // every part of a battle's identity changes its seed, and nothing else
+    uint64_t seed = battle_seed(7, 1, 2, 3);
+    TEST_ASSERT_TRUE(seed == battle_seed(7, 1, 2, 3));
+    TEST_ASSERT_TRUE(seed != battle_seed(8, 1, 2, 3));
+    TEST_ASSERT_TRUE(seed != battle_seed(7, 2, 1, 3));
+    TEST_ASSERT_TRUE(seed != battle_seed(7, 1, 2, 4));
+    TEST_ASSERT_TRUE(seed != battle_seed(7ull << 32, 1, 2, 3));
+
+    // so a battle is placed the same way whatever was played before it
+    mars fresh = create_mars(8000, 100, 20000);
+    mars used = create_mars(8000, 100, 20000);
+
+    get_block(&used);
+    reset_mars(&used);
+    seed_mars(&fresh, seed);
+    seed_mars(&used, seed);
+
+    for(unsigned int i=0; i<10; i++) {
+        TEST_ASSERT_EQUAL(get_block(&fresh), get_block(&used));
+    }
+
+    destroy_mars(&fresh);
+    destroy_mars(&used);
+}
+
+void test_block_allocator(void) {
+    mars m = create_mars(1000, 10, 100);
+    unsigned int blocks[100];
+    bool seen[100] = { false };
+
+    seed_mars(&m, 99);
+    TEST_ASSERT_EQUAL(100, m.free_count);
+
+    // a batch hands out distinct blocks, as many as are free
+    TEST_ASSERT_EQUAL(60, get_blocks(&m, 60, blocks));
+    TEST_ASSERT_EQUAL(40, get_blocks(&m, 60, &blocks[60]));
+    TEST_ASSERT_EQUAL(0, m.free_count);
+    TEST_ASSERT_EQUAL(UINT_MAX, get_block(&m));
+
+    for(unsigned int i=0; i<100; i++) {
+        TEST_ASSERT_FALSE(seen[blocks[i]]);
+        TEST_ASSERT_TRUE(m.blocks[blocks[i]]);
+        seen[blocks[i]] = true;
+    }
+
+    // released blocks are the only ones that can be chosen again, once each
+    release_block(&m, 17);
+    release_block(&m, 17);
+    release_block(&m, 42);
+    TEST_ASSERT_EQUAL(2, m.free_count);
+    TEST_ASSERT_FALSE(m.blocks[17]);
+
+    unsigned int first = get_block(&m);
+    unsigned int second = get_block(&m);
+    TEST_ASSERT_TRUE((first == 17 && second == 42) || (first == 42 && second == 17));
+    TEST_ASSERT_EQUAL(UINT_MAX, get_block(&m));
+
+    reset_mars(&m);
+    TEST_ASSERT_EQUAL(100, m.free_count);
+    destroy_mars(&m);
+}
+
+void test_place_programs(void) {
+    mars m = create_mars(1000, 10, 100);
+    program warriors[101];
+
+    for(unsigned int i=0; i<101; i++) {
+        warriors[i] = prog_from_buffer(i, DWARF, 4);
+    }
+
+    // a full melee takes every block, after which nothing more fits
+    TEST_ASSERT_EQUAL(100, place_programs(&m, warriors, 101));
+    TEST_ASSERT_EQUAL(100, m.warrior_count);
+    TEST_ASSERT_EQUAL(0, m.free_count);
+
+    // the last program loaded moves first
+    TEST_ASSERT_EQUAL(99, m.warriors[m.next_warrior].id);
+
+    for(unsigned int i=0; i<100; i++) {
+        unsigned int pc = m.warriors[i].PC;
+
+        TEST_ASSERT_TRUE(pc % 10 <= 6);
+        TEST_ASSERT_EQUAL_HEX32(DWARF[0], m.core[pc]);
+    }
+
+    // a program longer than a block gives its block back
+    reset_mars(&m);
+    program big = prog_from_buffer(0, GEMINI, 10);
+    big.size = 11;
+    TEST_ASSERT_EQUAL(1, place_programs(&m, warriors, 1));
+    TEST_ASSERT_EQUAL(0, place_programs(&m, &big, 1));
+    TEST_ASSERT_EQUAL(99, m.free_count);
+
+    destroy_program(&big);
+
+    for(unsigned int i=0; i<101; i++) {
+        destroy_program(&warriors[i]);
+    }
+
+    destroy_mars(&m);
+}
 
 int main() {
     UNITY_BEGIN();
@@ -866,12 +2361,15 @@ int main() {
     RUN_TEST(test_create_mars_2);
     RUN_TEST(test_insert_warrior_empty);
     RUN_TEST(test_insert_warrior);
+    RUN_TEST(test_insert_warrior_full);
     RUN_TEST(test_remove_warrior_middle);
     RUN_TEST(test_remove_warrior_next);
     RUN_TEST(test_remove_warrior_only);
     RUN_TEST(test_load_program);
+    RUN_TEST(test_load_program_bounds);
     RUN_TEST(test_get_operand_value);
     RUN_TEST(test_get_operand_address);
+    RUN_TEST(test_predecode);
     RUN_TEST(test_mov_immediate_relative);
     RUN_TEST(test_mov_immediate_indirect);
     RUN_TEST(test_mov_relative_relative);
@@ -911,6 +2409,20 @@ int main() {
     RUN_TEST(test_cmp_indirect_immediate);
     RUN_TEST(test_cmp_indirect_relative);
     RUN_TEST(test_cmp_indirect_indirect);
+    RUN_TEST(test_illegal_instructions);
+    RUN_TEST(test_event_log);
+    RUN_TEST(test_play_winner);
+    RUN_TEST(test_play_fast_matches_play);
+    RUN_TEST(test_fixed_size_engines);
+    RUN_TEST(test_cycle_detection);
+    RUN_TEST(test_run_cycles);
+    RUN_TEST(test_imp_fast_forward);
+    RUN_TEST(test_reset_mars);
+    RUN_TEST(test_mars_pool);
+    RUN_TEST(test_seed_mars);
+    RUN_TEST(test_battle_seed);
+    RUN_TEST(test_block_allocator);
+    RUN_TEST(test_place_programs);
     UNITY_END();
 
     return 0;
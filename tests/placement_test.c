@@ -0,0 +1,125 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#define TEST_BUILD
+
+#include "../lib/unity/unity.h"
+#include "../src/mars.h"
+#include "../src/placement.h"
+#include "fixtures.h"
+
+void test_stratified_sample(void) {
+    uint64_t rng = 1;
+    unsigned int hits[100] = { 0 };
+
+    // one draw from each of 10 strata lands once in each tenth of the range
+    for(unsigned int trial=0; trial<50; trial++) {
+        for(unsigned int stratum=0; stratum<10; stratum++) {
+            unsigned int sample = stratified_sample(100, stratum, 10, &rng);
+
+            TEST_ASSERT_EQUAL(stratum, sample / 10);
+            hits[sample]++;
+        }
+    }
+
+    // and the draws cover each stratum, rather than always picking its start
+    for(unsigned int tenth=0; tenth<10; tenth++) {
+        unsigned int covered = 0;
+
+        for(unsigned int i=0; i<10; i++) {
+            covered += hits[tenth * 10 + i] != 0;
+        }
+
+        TEST_ASSERT_TRUE(covered > 5);
+    }
+
+    // as many strata as numbers gives each number once
+    for(unsigned int i=0; i<7; i++) {
+        TEST_ASSERT_EQUAL(i, stratified_sample(7, i, 7, &rng));
+    }
+
+    // more strata than numbers stays in range
+    for(unsigned int i=0; i<20; i++) {
+        TEST_ASSERT_TRUE(stratified_sample(3, i, 20, &rng) < 3);
+    }
+}
+
+void test_load_pair(void) {
+    mars m = create_mars(8000, 256, 100);
+    program dwarf = prog_from_buffer(0, DWARF, 4);
+    program imp = prog_from_buffer(1, IMP, 1);
+
+    unsigned int index = load_pair(&m, &dwarf, &imp, 1000);
+
+    // the second program is loaded last, so it moves first
+    TEST_ASSERT_EQUAL(1, index);
+    TEST_ASSERT_EQUAL(index, m.next_warrior);
+    TEST_ASSERT_EQUAL(0, m.warriors[0].PC);
+    TEST_ASSERT_EQUAL(1000, m.warriors[1].PC);
+    TEST_ASSERT_EQUAL_HEX32(DWARF[3], m.core[3]);
+    TEST_ASSERT_EQUAL_HEX32(IMP[0], m.core[1000]);
+
+    // programs which would overlap are refused
+    reset_mars(&m);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_pair(&m, &dwarf, &imp, 3));
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_pair(&m, &imp, &dwarf, 7997));
+    TEST_ASSERT_EQUAL(0, m.warrior_count);
+
+    TEST_ASSERT_EQUAL(1, load_pair(&m, &imp, &dwarf, 7996));
+    TEST_ASSERT_EQUAL_HEX32(DWARF[3], m.core[7999]);
+
+    destroy_program(&dwarf);
+    destroy_program(&imp);
+    destroy_mars(&m);
+}
+
+void test_pair_distances(void) {
+    program dwarf = prog_from_buffer(0, DWARF, 4);
+    program imp = prog_from_buffer(1, IMP, 1);
+    mars m = create_mars(8000, 256, 100);
+
+    // distances run from the end of the first program to where the second
+    // would wrap round onto it
+    unsigned int count = pair_distances(8000, &dwarf, &imp);
+    TEST_ASSERT_EQUAL(7996, count);
+    TEST_ASSERT_EQUAL(1, load_pair(&m, &dwarf, &imp, 4));
+    reset_mars(&m);
+    TEST_ASSERT_EQUAL(1, load_pair(&m, &dwarf, &imp, 4 + count - 1));
+    reset_mars(&m);
+    TEST_ASSERT_EQUAL(NO_WARRIOR, load_pair(&m, &dwarf, &imp, 4 + count));
+
+    // programs which fill the core have one distance, and larger ones none
+    TEST_ASSERT_EQUAL(1, pair_distances(5, &dwarf, &imp));
+    TEST_ASSERT_EQUAL(0, pair_distances(4, &dwarf, &imp));
+
+    destroy_program(&dwarf);
+    destroy_program(&imp);
+    destroy_mars(&m);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stratified_sample);
+    RUN_TEST(test_load_pair);
+    RUN_TEST(test_pair_distances);
+    UNITY_END();
+
+    return 0;
+}
@@ -20,7 +20,9 @@
 
 #define TEST_BUILD
 
+#include <limits.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../lib/unity/unity.h"
 #include "../src/program.h"
@@ -121,6 +123,40 @@ void test_prog_from_file_dwarf(void) {
     destroy_program(&prog);
 }
 
+void test_prog_from_file_invalid(void) {
+    FILE* f = tmpfile();
+    program prog;
+
+    // one opcode more than a program may have
+    for(unsigned int i=0; i<=MAX_PROGRAM_SIZE; i++) {
+        fwrite("\x01\x00\x00\x15", 1, sizeof(opcode), f);
+    }
+
+    prog = prog_from_file(3, f);
+    TEST_ASSERT_EQUAL(UINT_MAX, prog.id);
+    destroy_program(&prog);
+
+    // a partial opcode
+    fflush(f);
+    TEST_ASSERT_EQUAL(0, ftruncate(fileno(f), 6));
+    prog = prog_from_file(3, f);
+    TEST_ASSERT_EQUAL(UINT_MAX, prog.id);
+    destroy_program(&prog);
+
+    // just right
+    TEST_ASSERT_EQUAL(0, ftruncate(fileno(f), 8));
+    prog = prog_from_file(3, f);
+    TEST_ASSERT_EQUAL(3, prog.id);
+    TEST_ASSERT_EQUAL(2, prog.size);
+    TEST_ASSERT_EQUAL(0x15000001, prog.code[0]);
+    destroy_program(&prog);
+
+    prog = prog_from_file(3, NULL);
+    TEST_ASSERT_EQUAL(UINT_MAX, prog.id);
+
+    fclose(f);
+}
+
 int main() {
     UNITY_BEGIN();
     RUN_TEST(test_prog_from_buffer);
@@ -128,6 +164,7 @@ int main() {
     RUN_TEST(test_prog_from_file_nop);
     RUN_TEST(test_prog_from_file_imp);
     RUN_TEST(test_prog_from_file_dwarf);
+    RUN_TEST(test_prog_from_file_invalid);
     UNITY_END();
 
     return 0;
@@ -0,0 +1,126 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#define TEST_BUILD
+
+#include <limits.h>
+
+#include "../lib/unity/unity.h"
+#include "../src/mars.h"
+#include "../src/scan.h"
+
+void test_enable_core_fields(void) {
+    mars m = create_mars(40, 10, 100);
+    warrior* w = &m.warriors[insert_warrior(&m, 0, 0)];
+
+    m.core[3] = 0x1A001FFE; // MOV @1 @-2
+    predecode(&m, 3);
+    enable_core_fields(&m);
+
+    TEST_ASSERT_EQUAL(MOV_TYPE, m.fields->type[3]);
+    TEST_ASSERT_EQUAL(INDIRECT_MODE, m.fields->a_mode[3]);
+    TEST_ASSERT_EQUAL(INDIRECT_MODE, m.fields->b_mode[3]);
+    TEST_ASSERT_EQUAL(0x001, m.fields->a[3]);
+    TEST_ASSERT_EQUAL(0xFFE, m.fields->b[3]);
+
+    // writes made by the simulator keep the arrays in sync
+    m.core[20] = 0x15000001; // MOV 0 1
+    predecode(&m, 20);
+    w->PC = 20;
+    tick(&m);
+
+    TEST_ASSERT_EQUAL(MOV_TYPE, m.fields->type[21]);
+    TEST_ASSERT_EQUAL(RELATIVE_MODE, m.fields->a_mode[21]);
+    TEST_ASSERT_EQUAL(0x000, m.fields->a[21]);
+    TEST_ASSERT_EQUAL(0x001, m.fields->b[21]);
+
+    destroy_mars(&m);
+}
+
+void test_count_type(void) {
+    mars m = create_mars(100, 10, 100);
+
+    for(unsigned int i=0; i<100; i += 3) {
+        m.core[i] = 0x15000001; // MOV 0 1
+        predecode(&m, i);
+    }
+
+    m.core[99] = 0x41000FFE; // JMP -2
+    predecode(&m, 99);
+
+    // with and without the field arrays
+    for(unsigned int pass=0; pass<2; pass++) {
+        unsigned int counts[16];
+        count_types(&m, counts);
+
+        TEST_ASSERT_EQUAL(33, count_type(&m, MOV_TYPE));
+        TEST_ASSERT_EQUAL(1, counts[JMP_TYPE]);
+        TEST_ASSERT_EQUAL(66, counts[DAT_TYPE]);
+        TEST_ASSERT_EQUAL(0, counts[CMP_TYPE]);
+
+        enable_core_fields(&m);
+    }
+
+    destroy_mars(&m);
+}
+
+void test_find_nonzero(void) {
+    mars m = create_mars(37, 10, 100);
+
+    TEST_ASSERT_EQUAL(UINT_MAX, find_nonzero(&m, 0));
+
+    m.core[9] = 1;
+    m.core[36] = 0x80000000;
+
+    TEST_ASSERT_EQUAL(9, find_nonzero(&m, 0));
+    TEST_ASSERT_EQUAL(9, find_nonzero(&m, 9));
+    TEST_ASSERT_EQUAL(36, find_nonzero(&m, 10));
+    TEST_ASSERT_EQUAL(UINT_MAX, find_nonzero(&m, 37));
+
+    destroy_mars(&m);
+}
+
+void test_compare_regions(void) {
+    opcode a[11] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    opcode b[11] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+    TEST_ASSERT_EQUAL(11, compare_regions(a, b, 11));
+
+    b[10] = 0;
+    TEST_ASSERT_EQUAL(10, compare_regions(a, b, 11));
+    TEST_ASSERT_EQUAL(10, compare_regions(a, b, 10));
+
+    b[5] = 0;
+    TEST_ASSERT_EQUAL(5, compare_regions(a, b, 11));
+
+    b[0] = 0;
+    TEST_ASSERT_EQUAL(0, compare_regions(a, b, 11));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_enable_core_fields);
+    RUN_TEST(test_count_type);
+    RUN_TEST(test_find_nonzero);
+    RUN_TEST(test_compare_regions);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/* Copyright 2018 Jacob Weightman
+ *
+ * This file is part of corewars-1984.
+ *
+ * corewars-1984 is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3
+ * of the License, or (at your option) any later version.
+ *
+ * corewars-1984 is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Author: Jacob Weightman <jacobdweightman@gmail.com>
+ */
+
+#include <time.h>
+
+#include "../lib/unity/unity.h"
+#include "../src/schedule.h"
+#include "../src/topology.h"
+
+#define TASKS 500
+
+/* Counts the runs of each task of a batch, some of which take far longer than
+ * the others. */
+void count_run(void* context, unsigned int task, unsigned int worker) {
+    unsigned int* runs = (unsigned int*) context;
+
+    (void) worker;
+
+    if(task % 97 == 0) {
+        struct timespec pause = { 0, 2000000 };
+        nanosleep(&pause, NULL);
+    }
+
+    __atomic_add_fetch(&runs[task], 1, __ATOMIC_RELAXED);
+}
+
+/* Runs a batch of the given size and checks that every task ran once. */
+void check_batch(unsigned int task_count, unsigned int threads) {
+    unsigned int runs[TASKS] = { 0 };
+    worker_stats stats[8];
+    unsigned int total = 0;
+    unsigned int stolen = 0;
+
+    run_batch(task_count, threads, count_run, runs, false, stats);
+
+    for(unsigned int i=0; i<task_count; i++) {
+        TEST_ASSERT_EQUAL(1, runs[i]);
+    }
+
+    for(unsigned int i=0; i<threads; i++) {
+        TEST_ASSERT_TRUE(stats[i].stolen <= stats[i].tasks);
+        TEST_ASSERT_TRUE(stats[i].busy >= 0.0);
+        TEST_ASSERT_TRUE(stats[i].idle >= 0.0);
+        total += stats[i].tasks;
+        stolen += stats[i].stolen;
+    }
+
+    // a task is counted as stolen by the worker which ran it, however many
+    // times its range was stolen on
+    TEST_ASSERT_EQUAL(task_count, total);
+    TEST_ASSERT_TRUE(stolen <= task_count);
+}
+
+void test_run_batch(void) {
+    check_batch(TASKS, 1);
+    check_batch(TASKS, 4);
+    check_batch(TASKS, 8);
+    check_batch(3, 8);
+    check_batch(0, 2);
+}
+
+/* A task which is slow in the first half of a batch of TASKS. */
+void slow_first_half(void* context, unsigned int task, unsigned int worker) {
+    if(task < TASKS / 2) {
+        struct timespec pause = { 0, 200000 };
+        nanosleep(&pause, NULL);
+    }
+
+    count_run(context, task, worker);
+}
+
+void test_work_stealing(void) {
+    unsigned int runs[TASKS] = { 0 };
+    worker_stats stats[2];
+
+    // the slow half starts out with the first worker, so the second runs out
+    // of work early and has to steal from it
+    run_batch(TASKS, 2, slow_first_half, runs, false, stats);
+
+    for(unsigned int i=0; i<TASKS; i++) {
+        TEST_ASSERT_EQUAL(1, runs[i]);
+    }
+
+    TEST_ASSERT_TRUE(stats[1].stolen > 0);
+    TEST_ASSERT_TRUE(stats[0].stolen + stats[1].stolen <= TASKS);
+    TEST_ASSERT_TRUE(stats[1].tasks > TASKS / 2);
+    TEST_ASSERT_EQUAL(TASKS, stats[0].tasks + stats[1].tasks);
+}
+
+/* Records which worker ran each task of a batch of TASKS. */
+void record_worker(void* context, unsigned int task, unsigned int worker) {
+    unsigned int* workers = (unsigned int*) context;
+
+    workers[task] = worker;
+}
+
+void test_pinned_batch(void) {
+    unsigned int workers[TASKS];
+    unsigned int cpus[MAX_CPUS];
+    unsigned int cpu_count = usable_cpus(cpus, MAX_CPUS);
+    worker_stats stats[4];
+
+    TEST_ASSERT_TRUE(cpu_count > 0);
+
+    run_batch(TASKS, 4, record_worker, workers, true, stats);
+
+    for(unsigned int i=0; i<TASKS; i++) {
+        TEST_ASSERT_TRUE(workers[i] < 4);
+    }
+
+    // workers are pinned to the usable CPUs in turn
+    for(unsigned int i=0; i<4; i++) {
+        TEST_ASSERT_EQUAL_INT(cpus[i % cpu_count], stats[i].cpu);
+    }
+
+    run_batch(TASKS, 2, record_worker, workers, false, stats);
+    TEST_ASSERT_EQUAL_INT(-1, stats[0].cpu);
+    TEST_ASSERT_EQUAL_INT(-1, stats[1].cpu);
+}
+
+void test_cpu_node(void) {
+    unsigned int cpus[MAX_CPUS];
+    unsigned int cpu_count = usable_cpus(cpus, MAX_CPUS);
+    FILE* nodes = fopen("/sys/devices/system/node/possible", "r");
+
+    // where the kernel knows about NUMA nodes, every usable CPU is on one
+    if(nodes != NULL) {
+        fclose(nodes);
+
+        for(unsigned int i=0; i<cpu_count; i++) {
+            TEST_ASSERT_TRUE(cpu_node(cpus[i]) >= 0);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(-1, cpu_node(MAX_CPUS * 1000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_run_batch);
+    RUN_TEST(test_work_stealing);
+    RUN_TEST(test_pinned_batch);
+    RUN_TEST(test_cpu_node);
+    UNITY_END();
+
+    return 0;
+}